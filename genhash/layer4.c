@@ -104,7 +104,6 @@ tcp_socket_state(int fd, thread_t * thread, char *ipaddress, uint16_t addr_port,
 	int status;
 	socklen_t slen;
 	int ret = 0;
-	timeval_t timer_min;
 
 	/* Handle connection timeout */
 	if (thread->type == THREAD_WRITE_TIMEOUT) {
@@ -137,9 +136,8 @@ tcp_socket_state(int fd, thread_t * thread, char *ipaddress, uint16_t addr_port,
 		DBG("TCP connection to [%s]:%d still IN_PROGRESS.\n",
 		    ipaddress, ntohs(addr_port));
 
-		timer_min = timer_sub_now(thread->sands);
 		thread_add_write(thread->master, func, THREAD_ARG(thread)
-				 , thread->u.fd, timer_long(timer_min));
+				 , thread->u.fd, thread_time_to_wakeup(thread));
 		return connect_in_progress;
 	}
 
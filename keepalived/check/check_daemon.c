@@ -142,6 +142,8 @@ start_check(void)
 	if (global_data->checker_no_swap)
 		set_process_dont_swap(4096);	/* guess a stack size to reserve */
 
+	thread_set_pool_max(master, global_data->thread_pool_max);
+
 	/* Processing differential configuration parsing */
 	if (reload)
 		clear_diff_services();
@@ -174,6 +176,20 @@ sighup_check(void *v, int sig)
 	thread_add_event(master, reload_check_thread, NULL, 0);
 }
 
+/* Scheduler statistics handler */
+static void
+sigusr2_check(void *v, int sig)
+{
+	thread_alloc_stats_t stats;
+
+	thread_get_alloc_stats(master, &stats);
+	log_message(LOG_INFO, "Scheduler threads: %lu allocated, %lu in use, %lu pooled, %lu chunks",
+		    stats.alloc, stats.in_use, stats.pooled, stats.chunks);
+#ifdef _WITH_THREAD_STATS_
+	thread_dump_stats(master, NULL);
+#endif
+}
+
 /* Terminate handler */
 static void
 sigend_check(void *v, int sig)
@@ -188,6 +204,7 @@ check_signal_init(void)
 {
 	signal_handler_init();
 	signal_set(SIGHUP, sighup_check, NULL);
+	signal_set(SIGUSR2, sigusr2_check, NULL);
 	signal_set(SIGINT, sigend_check, NULL);
 	signal_set(SIGTERM, sigend_check, NULL);
 	signal_ignore(SIGPIPE);
@@ -30,7 +30,7 @@
 #include "parser.h"
 #include "utils.h"
 #include "html.h"
-#ifndef _HAVE_SOCK_CLOEXEC_
+#if !defined _HAVE_SOCK_NONBLOCK_ || !defined _HAVE_SOCK_CLOEXEC_
 #include "old_socket.h"
 #include "string.h"
 #endif
@@ -469,23 +469,15 @@ http_read_thread(thread_t * thread)
 	unsigned timeout = checker->co->connection_to;
 	unsigned char digest[16];
 	int r = 0;
-	int val;
 
 	/* Handle read timeout */
 	if (thread->type == THREAD_READ_TIMEOUT)
 		return timeout_epilog(thread, "Timeout HTTP read");
 
-	/* Set descriptor non blocking */
-	val = fcntl(thread->u.fd, F_GETFL, 0);
-	fcntl(thread->u.fd, F_SETFL, val | O_NONBLOCK);
-
 	/* read the HTTP stream */
 	r = read(thread->u.fd, req->buffer + req->len,
 		 MAX_BUFFER_LENGTH - req->len);
 
-	/* restore descriptor flags */
-	fcntl(thread->u.fd, F_SETFL, val);
-
 	/* Test if data are ready */
 	if (r == -1 && (errno == EAGAIN || errno == EINTR)) {
 		log_message(LOG_INFO, "Read error with server %s: %s"
@@ -578,7 +570,6 @@ http_request_thread(thread_t * thread)
 	char *str_request;
 	url_t *fetched_url;
 	int ret = 0;
-	int val;
 
 	/* Handle read timeout */
 	if (thread->type == THREAD_WRITE_TIMEOUT)
@@ -618,10 +609,6 @@ http_request_thread(thread_t * thread)
 	    http->url_it + 1
 	    , FMT_HTTP_RS(checker));
 
-	/* Set descriptor non blocking */
-	val = fcntl(thread->u.fd, F_GETFL, 0);
-	fcntl(thread->u.fd, F_SETFL, val | O_NONBLOCK);
-
 	/* Send the GET request to remote Web server */
 	if (http_get_check->proto == PROTO_SSL) {
 		ret = ssl_send_request(req->ssl, str_request,
@@ -631,9 +618,6 @@ http_request_thread(thread_t * thread)
 		       -1) ? 1 : 0;
 	}
 
-	/* restore descriptor flags */
-	fcntl(thread->u.fd, F_SETFL, val);
-
 	FREE(str_request);
 
 	if (!ret) {
@@ -680,7 +664,7 @@ http_check_thread(thread_t * thread)
 				new_req = 0;
 
 			if (http_get_check->proto == PROTO_SSL) {
-				timeout = timer_long(thread->sands) - timer_long(time_now);
+				timeout = thread_time_to_wakeup(thread);
 				if (thread->type != THREAD_WRITE_TIMEOUT &&
 				    thread->type != THREAD_READ_TIMEOUT)
 					ret = ssl_connect(thread, new_req);
@@ -766,7 +750,7 @@ http_connect_thread(thread_t * thread)
 		return epilog(thread, 1, 1, 0) + 1;
 
 	/* Create the socket */
-	if ((fd = socket(co->dst.ss_family, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP)) == -1) {
+	if ((fd = socket(co->dst.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP)) == -1) {
 		log_message(LOG_INFO, "WEB connection fail to create socket. Rescheduling.");
 		thread_add_timer(thread->master, http_connect_thread, checker,
 				checker->vs->delay_loop);
@@ -778,6 +762,10 @@ http_connect_thread(thread_t * thread)
 	if (set_sock_flags(fd, F_SETFD, FD_CLOEXEC))
 		log_message(LOG_INFO, "Unable to set CLOEXEC on http_connect socket - %s (%d)", strerror(errno), errno);
 #endif
+#ifndef _HAVE_SOCK_NONBLOCK_
+	if (set_sock_flags(fd, F_SETFL, O_NONBLOCK))
+		log_message(LOG_INFO, "Unable to set NONBLOCK on http_connect socket - %s (%d)", strerror(errno), errno);
+#endif
 
 	status = tcp_bind_connect(fd, co);
 
@@ -31,7 +31,7 @@
 #include "utils.h"
 #include "parser.h"
 #include "daemon.h"
-#ifndef _HAVE_SOCK_CLOEXEC_
+#if !defined _HAVE_SOCK_NONBLOCK_ || !defined _HAVE_SOCK_CLOEXEC_
 #include "old_socket.h"
 #include "string.h"
 #endif
@@ -345,7 +345,7 @@ smtp_get_line_cb(thread_t *thread)
 	checker_t *checker = THREAD_ARG(thread);
 	smtp_checker_t *smtp_checker = CHECKER_ARG(checker);
 	smtp_host_t *smtp_host = smtp_checker->host_ptr;
-	int f, r, x;
+	int r, x;
 
 	/* Handle read timeout */
 	if (thread->type == THREAD_READ_TIMEOUT) {
@@ -362,10 +362,6 @@ smtp_get_line_cb(thread_t *thread)
 		smtp_clear_buff(thread);
 	}
 
-	/* Set descriptor non blocking */
-	f = fcntl(thread->u.fd, F_GETFL, 0);
-	fcntl(thread->u.fd, F_SETFL, f | O_NONBLOCK);
-
 	/* read the data */
 	r = read(thread->u.fd, smtp_checker->buff + smtp_checker->buff_ctr,
 		 SMTP_BUFF_MAX - smtp_checker->buff_ctr);
@@ -373,14 +369,10 @@ smtp_get_line_cb(thread_t *thread)
 	if (r == -1 && (errno == EAGAIN || errno == EINTR)) {
 		thread_add_read(thread->master, smtp_get_line_cb, checker,
 				thread->u.fd, smtp_host->connection_to);
-		fcntl(thread->u.fd, F_SETFL, f);
 		return 0;
 	} else if (r > 0)
 		smtp_checker->buff_ctr += r;
 
-	/* restore descriptor flags */
-	fcntl(thread->u.fd, F_SETFL, f);
-
 	/* check if we have a newline, if so, callback */
 	for (x = 0; x < SMTP_BUFF_MAX; x++) {
 		if (smtp_checker->buff[x] == '\n') {
@@ -456,7 +448,7 @@ smtp_put_line_cb(thread_t *thread)
 	checker_t *checker = THREAD_ARG(thread);
 	smtp_checker_t *smtp_checker = CHECKER_ARG(checker);
 	smtp_host_t *smtp_host = smtp_checker->host_ptr;
-	int f, w;
+	int w;
 
 
 	/* Handle read timeout */
@@ -466,23 +458,15 @@ smtp_put_line_cb(thread_t *thread)
 		return 0;
 	}
 
-	/* Set descriptor non blocking */
-	f = fcntl(thread->u.fd, F_GETFL, 0);
-	fcntl(thread->u.fd, F_SETFL, f | O_NONBLOCK);
-
 	/* write the data */
 	w = write(thread->u.fd, smtp_checker->buff, smtp_checker->buff_ctr);
 
 	if (w == -1 && (errno == EAGAIN || errno == EINTR)) {
 		thread_add_write(thread->master, smtp_put_line_cb, checker,
 				 thread->u.fd, smtp_host->connection_to);
-		fcntl(thread->u.fd, F_SETFL, f);
 		return 0;
 	}
 
-	/* restore descriptor flags */
-	fcntl(thread->u.fd, F_SETFL, f);
-
 	DBG("SMTP_CHECK %s > %s"
 	    , FMT_SMTP_RS(smtp_host)
 	    , smtp_checker->buff);
@@ -765,7 +749,7 @@ smtp_connect_thread(thread_t *thread)
 	smtp_host = smtp_checker->host_ptr;
 
 	/* Create the socket, failling here should be an oddity */
-	if ((sd = socket(smtp_host->dst.ss_family, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP)) == -1) {
+	if ((sd = socket(smtp_host->dst.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP)) == -1) {
 		log_message(LOG_INFO, "SMTP_CHECK connection failed to create socket. Rescheduling.");
 		thread_add_timer(thread->master, smtp_connect_thread, checker,
 				 checker->vs->delay_loop);
@@ -775,6 +759,10 @@ smtp_connect_thread(thread_t *thread)
 	if (set_sock_flags(sd, F_SETFD, FD_CLOEXEC))
 		log_message(LOG_INFO, "Unable to set CLOEXEC on smtp socket - %s (%d)", strerror(errno), errno);
 #endif
+#ifndef _HAVE_SOCK_NONBLOCK_
+	if (set_sock_flags(sd, F_SETFL, O_NONBLOCK))
+		log_message(LOG_INFO, "Unable to set NONBLOCK on smtp socket - %s (%d)", strerror(errno), errno);
+#endif
 
 	status = tcp_bind_connect(sd, smtp_host);
 
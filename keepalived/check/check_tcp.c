@@ -29,7 +29,7 @@
 #include "smtp.h"
 #include "utils.h"
 #include "parser.h"
-#ifndef _HAVE_SOCK_CLOEXEC_
+#if !defined _HAVE_SOCK_NONBLOCK_ || !defined _HAVE_SOCK_CLOEXEC_
 #include "old_socket.h"
 #include "string.h"
 #endif
@@ -201,7 +201,7 @@ tcp_connect_thread(thread_t * thread)
 		return 0;
 	}
 
-	if ((fd = socket(co->dst.ss_family, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP)) == -1) {
+	if ((fd = socket(co->dst.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP)) == -1) {
 		log_message(LOG_INFO, "TCP connect fail to create socket. Rescheduling.");
 		thread_add_timer(thread->master, tcp_connect_thread, checker,
 				checker->vs->delay_loop);
@@ -213,6 +213,10 @@ tcp_connect_thread(thread_t * thread)
 	if (set_sock_flags(fd, F_SETFD, FD_CLOEXEC))
 		log_message(LOG_INFO, "Unable to set CLOEXEC on tcp_connect socket - %s (%d)", strerror(errno), errno);
 #endif
+#ifndef _HAVE_SOCK_NONBLOCK_
+	if (set_sock_flags(fd, F_SETFL, O_NONBLOCK))
+		log_message(LOG_INFO, "Unable to set NONBLOCK on tcp_connect socket - %s (%d)", strerror(errno), errno);
+#endif
 
 	status = tcp_bind_connect(fd, co);
 
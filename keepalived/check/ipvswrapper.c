@@ -37,6 +37,7 @@
 #include "utils.h"
 #include "memory.h"
 #include "logger.h"
+#include "signals.h"
 
 /*
  * Utility functions coming from Wensong code
@@ -133,6 +134,8 @@ modprobe_ipvs(void)
 	sigaction ( SIGCHLD, &act, &old_act);
 
 	if (!(child = fork())) {
+		signal_handler_script();
+
 		execv(argv[0], argv);
 		exit(1);
 	}
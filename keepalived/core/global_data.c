@@ -31,6 +31,7 @@
 #include "utils.h"
 #include "vrrp.h"
 #include "main.h"
+#include "scheduler.h"
 
 /* global vars */
 data_t *global_data = NULL;
@@ -141,6 +142,7 @@ alloc_global_data(void)
 
 	set_default_mcast_group(new);
 	set_vrrp_defaults(new);
+	new->thread_pool_max = THREAD_POOL_MAX;
 
 #ifdef _WITH_SNMP_
 	if (snmp) {
@@ -293,6 +295,7 @@ dump_global_data(data_t * data)
 	log_message(LOG_INFO, " Send advert after receive lower priority advert = %s", data->vrrp_lower_prio_no_advert ? "false" : "true");
 	log_message(LOG_INFO, " Gratuitous ARP interval = %d", data->vrrp_garp_interval);
 	log_message(LOG_INFO, " Gratuitous NA interval = %d", data->vrrp_gna_interval);
+	log_message(LOG_INFO, " VRRP advert coalescing window = %d", data->vrrp_tx_coalesce);
 	log_message(LOG_INFO, " VRRP default protocol version = %d", data->vrrp_version);
 	if (data->vrrp_iptables_inchain[0])
 		log_message(LOG_INFO," Iptables input chain = %s", data->vrrp_iptables_inchain);
@@ -315,6 +318,7 @@ dump_global_data(data_t * data)
 	log_message(LOG_INFO, " Checker process priority = %d", data->checker_process_priority);
 	log_message(LOG_INFO, " VRRP don't swap = %s", data->vrrp_no_swap ? "true" : "false");
 	log_message(LOG_INFO, " Checker don't swap = %s", data->checker_no_swap ? "true" : "false");
+	log_message(LOG_INFO, " Thread pool max = %lu", data->thread_pool_max);
 #ifdef _WITH_SNMP_KEEPALIVED_
 	log_message(LOG_INFO, " SNMP keepalived %s", data->enable_snmp_keepalived ? "enabled" : "disabled");
 #endif
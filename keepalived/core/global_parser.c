@@ -359,6 +359,16 @@ vrrp_gna_interval_handler(vector_t *strvec)
 		log_message(LOG_INFO, "The vrrp_gna_interval is very large - %s seconds", FMT_STR_VSLOT(strvec, 1));
 }
 static void
+vrrp_tx_coalesce_handler(vector_t *strvec)
+{
+	global_data->vrrp_tx_coalesce = atof(vector_slot(strvec, 1)) * 1000000;
+	if (global_data->vrrp_tx_coalesce > VRRP_TX_COALESCE_MAX) {
+		log_message(LOG_INFO, "The vrrp_tx_coalesce window %s is too large, using %g seconds",
+			    FMT_STR_VSLOT(strvec, 1), (double) VRRP_TX_COALESCE_MAX / 1000000);
+		global_data->vrrp_tx_coalesce = VRRP_TX_COALESCE_MAX;
+	}
+}
+static void
 vrrp_lower_prio_no_advert_handler(vector_t *strvec)
 {
 	int res;
@@ -514,6 +524,24 @@ checker_no_swap_handler(vector_t *strvec)
 {
 	global_data->checker_no_swap = true;
 }
+static void
+thread_pool_max_handler(vector_t *strvec)
+{
+	long pool_max;
+
+	if (vector_size(strvec) < 2) {
+		log_message(LOG_INFO, "No thread pool max specified");
+		return;
+	}
+
+	pool_max = atol(vector_slot(strvec, 1));
+	if (pool_max < 0) {
+		log_message(LOG_INFO, "Invalid thread pool max specified");
+		return;
+	}
+
+	global_data->thread_pool_max = pool_max;
+}
 #ifdef _WITH_SNMP_
 static void
 snmp_socket_handler(vector_t *strvec)
@@ -613,6 +641,7 @@ global_init_keywords(void)
 	install_keyword("vrrp_garp_lower_prio_repeat", &vrrp_garp_lower_prio_rep_handler);
 	install_keyword("vrrp_garp_interval", &vrrp_garp_interval_handler);
 	install_keyword("vrrp_gna_interval", &vrrp_gna_interval_handler);
+	install_keyword("vrrp_tx_coalesce", &vrrp_tx_coalesce_handler);
 	install_keyword("vrrp_lower_prio_no_advert", &vrrp_lower_prio_no_advert_handler);
 	install_keyword("vrrp_version", &vrrp_version_handler);
 	install_keyword("vrrp_iptables", &vrrp_iptables_handler);
@@ -626,6 +655,7 @@ global_init_keywords(void)
 	install_keyword("checker_priority", &checker_prio_handler);
 	install_keyword("vrrp_no_swap", &vrrp_no_swap_handler);
 	install_keyword("checker_no_swap", &checker_no_swap_handler);
+	install_keyword("thread_pool_max", &thread_pool_max_handler);
 #ifdef _WITH_SNMP_
 	install_keyword("snmp_socket", &snmp_socket_handler);
 	install_keyword("enable_traps", &trap_handler);
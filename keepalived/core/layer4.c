@@ -25,13 +25,13 @@
 #include "utils.h"
 #include "logger.h"
 
+/* Connect a socket created non blocking, it is left non blocking */
 enum connect_result
 tcp_bind_connect(int fd, conn_opts_t *co)
 {
 	struct linger li;
 	socklen_t addrlen;
 	int ret;
-	int val;
 	struct sockaddr_storage *addr = &co->dst;
 	struct sockaddr_storage *bind_addr = &co->bindto;
 
@@ -40,10 +40,6 @@ tcp_bind_connect(int fd, conn_opts_t *co)
 	li.l_linger = 0;
 	setsockopt(fd, SOL_SOCKET, SO_LINGER, (char *) &li, sizeof (struct linger));
 
-	/* Make socket non-block. */
-	val = fcntl(fd, F_GETFL, 0);
-	fcntl(fd, F_SETFL, val | O_NONBLOCK);
-
 #ifdef _WITH_SO_MARK_
 	if (co->fwmark) {
 		if (setsockopt (fd, SOL_SOCKET, SO_MARK, &co->fwmark, sizeof (co->fwmark)) < 0) {
@@ -65,10 +61,8 @@ tcp_bind_connect(int fd, conn_opts_t *co)
 	ret = connect(fd, (struct sockaddr *) addr, addrlen);
 
 	/* Immediate success */
-	if (ret == 0) {
-		fcntl(fd, F_SETFL, val);
+	if (ret == 0)
 		return connect_success;
-	}
 
 	/* If connect is in progress then return 1 else it's real error. */
 	if (ret < 0) {
@@ -76,8 +70,6 @@ tcp_bind_connect(int fd, conn_opts_t *co)
 			return connect_error;
 	}
 
-	/* restore previous fd args */
-	fcntl(fd, F_SETFL, val);
 	return connect_in_progress;
 }
 
@@ -96,7 +88,6 @@ tcp_socket_state(int fd, thread_t * thread, int (*func) (thread_t *))
 	int status;
 	socklen_t addrlen;
 	int ret = 0;
-	timeval_t timer_min;
 
 	/* Handle connection timeout */
 	if (thread->type == THREAD_WRITE_TIMEOUT) {
@@ -121,9 +112,8 @@ tcp_socket_state(int fd, thread_t * thread, int (*func) (thread_t *))
 	 * Recompute the write timeout (or pending connection).
 	 */
 	if (status == EINPROGRESS) {
-		timer_min = timer_sub_now(thread->sands);
 		thread_add_write(thread->master, func, THREAD_ARG(thread),
-				 thread->u.fd, timer_long(timer_min));
+				 thread->u.fd, thread_time_to_wakeup(thread));
 		return connect_in_progress;
 	} else if (status != 0) {
 		close(thread->u.fd);
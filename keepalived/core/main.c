@@ -106,7 +106,7 @@ propogate_signal(void *v, int sig)
 	/* Signal child process */
 	if (vrrp_child > 0)
 		kill(vrrp_child, sig);
-	if (checkers_child > 0 && sig == SIGHUP)
+	if (checkers_child > 0 && (sig == SIGHUP || sig == SIGUSR2))
 		kill(checkers_child, sig);
 }
 
@@ -128,12 +128,11 @@ sigend(void *v, int sig)
 	thread_add_terminate_event(master);
 
 	log_message(LOG_INFO, "Stopping");
+	sigemptyset(&child_wait);
+	sigaddset(&child_wait, SIGCHLD);
 	sigprocmask(0, NULL, &old_set);
-	if (!sigismember(&old_set, SIGCHLD)) {
-		sigemptyset(&child_wait);
-		sigaddset(&child_wait, SIGCHLD);
+	if (!sigismember(&old_set, SIGCHLD))
 		sigprocmask(SIG_BLOCK, &child_wait, NULL);
-	}
 
 	if (vrrp_child > 0) {
 		kill(vrrp_child, SIGTERM);
@@ -282,6 +281,7 @@ usage(const char *prog)
 	fprintf(stderr, "  -V, --dont-release-vrrp      Don't remove VRRP VIPs and VROUTEs on daemon stop\n");
 	fprintf(stderr, "  -I, --dont-release-ipvs      Don't remove IPVS topology on daemon stop\n");
 	fprintf(stderr, "  -R, --dont-respawn           Don't respawn child processes\n");
+	fprintf(stderr, "  -s, --scoped-netlink         Only track the interfaces of the configuration\n");
 	fprintf(stderr, "  -n, --dont-fork              Don't fork the daemon process\n");
 	fprintf(stderr, "  -d, --dump-conf              Dump the configuration data\n");
 	fprintf(stderr, "  -p, --pid=FILE               Use specified pidfile for parent process\n");
@@ -317,6 +317,7 @@ parse_cmdline(int argc, char **argv)
 		{"dont-release-vrrp", no_argument,       0, 'V'},
 		{"dont-release-ipvs", no_argument,       0, 'I'},
 		{"dont-respawn",      no_argument,       0, 'R'},
+		{"scoped-netlink",    no_argument,       0, 's'},
 		{"dont-fork",         no_argument,       0, 'n'},
 		{"dump-conf",         no_argument,       0, 'd'},
 		{"pid",               required_argument, 0, 'p'},
@@ -336,7 +337,7 @@ parse_cmdline(int argc, char **argv)
 		{0, 0, 0, 0}
 	};
 
-	while ((c = getopt_long(argc, argv, "vhlndVIDRS:f:PCp:c:r:mML"
+	while ((c = getopt_long(argc, argv, "vhlndVIDRsS:f:PCp:c:r:mML"
 #ifdef _WITH_SNMP_
 					    "xA:"
 #endif
@@ -376,6 +377,9 @@ parse_cmdline(int argc, char **argv)
 		case 'R':
 			__set_bit(DONT_RESPAWN_BIT, &debug);
 			break;
+		case 's':
+			__set_bit(SCOPED_NETLINK_BIT, &debug);
+			break;
 		case 'X':
 			__set_bit(RELEASE_VIPS_BIT, &debug);
 			break;
@@ -23,6 +23,7 @@
  */
 
 #include <time.h>
+#include <fcntl.h>
 
 #include "smtp.h"
 #include "global_data.h"
@@ -32,7 +33,7 @@
 #include "list.h"
 #include "logger.h"
 #include "utils.h"
-#ifndef _HAVE_SOCK_CLOEXEC_
+#if !defined _HAVE_SOCK_NONBLOCK_ || !defined _HAVE_SOCK_CLOEXEC_
 #include "old_socket.h"
 #endif
 
@@ -137,10 +138,18 @@ static int
 connection_success(thread_t * thread)
 {
 	smtp_t *smtp = THREAD_ARG(thread);
+	int val;
 
 	log_message(LOG_INFO, "Remote SMTP server %s connected."
 			    , FMT_SMTP_HOST());
 
+	/* Only connect() is non blocking, the commands and the body are
+	 * written with plain send() */
+	val = fcntl(smtp->fd, F_GETFL);
+	if (val == -1 || fcntl(smtp->fd, F_SETFL, val & ~O_NONBLOCK) == -1)
+		log_message(LOG_INFO, "Unable to set blocking mode on SMTP socket - %s (%d)"
+				    , strerror(errno), errno);
+
 	smtp->stage = connect_success;
 	thread_add_read(thread->master, smtp_read_thread, smtp,
 			smtp->fd, global_data->smtp_connection_to);
@@ -584,7 +593,7 @@ smtp_connect(smtp_t * smtp)
 {
 	enum connect_result status;
 
-	if ((smtp->fd = socket(global_data->smtp_server.ss_family, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP)) == -1) {
+	if ((smtp->fd = socket(global_data->smtp_server.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP)) == -1) {
 		DBG("SMTP connect fail to create socket.");
 		free_smtp_all(smtp);
 		return;
@@ -594,6 +603,10 @@ smtp_connect(smtp_t * smtp)
 	if (set_sock_flags(smtp->fd, F_SETFD, FD_CLOEXEC))
 		log_message(LOG_INFO, "Unable to set CLOEXEC on smtp_connect socket - %s (%d)", strerror(errno), errno);
 #endif
+#ifndef _HAVE_SOCK_NONBLOCK_
+	if (set_sock_flags(smtp->fd, F_SETFL, O_NONBLOCK))
+		log_message(LOG_INFO, "Unable to set NONBLOCK on smtp_connect socket - %s (%d)", strerror(errno), errno);
+#endif
 
 	status = tcp_connect(smtp->fd, &global_data->smtp_server);
 
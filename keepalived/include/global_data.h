@@ -84,6 +84,7 @@ typedef struct _data {
 	int				vrrp_garp_lower_prio_rep;
 	int				vrrp_garp_interval;
 	int				vrrp_gna_interval;
+	int				vrrp_tx_coalesce;	/* usecs */
 	bool				vrrp_lower_prio_no_advert;
 	int				vrrp_version;	/* VRRP version (2 or 3) */
 	char				vrrp_iptables_inchain[XT_EXTENSION_MAXNAMELEN];
@@ -103,6 +104,7 @@ typedef struct _data {
 	char				checker_process_priority;
 	bool				vrrp_no_swap;
 	bool				checker_no_swap;
+	unsigned long			thread_pool_max;
 #ifdef _WITH_SNMP_
 	int				enable_traps;
 	char				*snmp_socket;
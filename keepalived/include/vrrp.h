@@ -112,6 +112,7 @@ typedef struct _vrrp_sgroup {
 typedef struct _vrrp_stats {
 	uint64_t	advert_rcvd;
 	uint32_t	advert_sent;
+	uint32_t	advert_send_err;
 
 	uint32_t	become_master;
 	uint32_t	release_master;
@@ -141,6 +142,19 @@ typedef struct _vrrp_stats {
 #endif
 } vrrp_stats;
 
+/* VIPs of an instance, hashed to check the address list of adverts */
+typedef struct _vrrp_vip_set {
+	ip_address_t		**vips;		/* VIPs in list order */
+	int			*hash;		/* index in vips + 1, 0 if free */
+	unsigned		hash_mask;
+	unsigned		*seen;		/* generation a VIP was last seen in */
+	unsigned		gen;
+	int			count;		/* distinct VIPs */
+	size_t			len;		/* length of the address list */
+	unsigned char		*last;		/* address list last accepted */
+	struct sockaddr_storage	last_saddr;	/* from this master, unset if none */
+} vrrp_vip_set_t;
+
 /* parameters per virtual router -- rfc2338.6.1.2 */
 typedef struct _vrrp_t {
 	sa_family_t		family;			/* AF_INET|AF_INET6 */
@@ -171,8 +185,6 @@ typedef struct _vrrp_t {
 	int			garp_rep;		/* gratuitous ARP repeat value */
 	int			garp_refresh_rep;	/* refresh gratuitous ARP repeat value */
 	int			garp_lower_prio_delay;	/* Delay to second set or ARP messages */
-	bool			garp_pending;		/* Are there gratuitous ARP messages still to be sent */
-	bool			gna_pending;		/* Are there gratuitous NA messages still to be sent */
 	int			garp_lower_prio_rep;	/* Number of ARP messages to send at a time */
 	int			lower_prio_no_advert;	/* Don't send advert after lower prio
 							 * advert received */
@@ -181,6 +193,7 @@ typedef struct _vrrp_t {
 	int			effective_priority;	/* effective priority value */
 	int			vipset;			/* All the vips are set ? */
 	list			vip;			/* list of virtual ip addresses */
+	vrrp_vip_set_t		*vip_set;		/* VIPs hashed to check adverts */
 	list			evip;			/* list of protocol excluded VIPs.
 							 * Those VIPs will not be presents into the
 							 * VRRP adverts
@@ -208,6 +221,7 @@ typedef struct _vrrp_t {
 	int			wantstate;		/* user explicitly wants a state (back/mast) */
 	int			fd_in;			/* IN socket descriptor */
 	int			fd_out;			/* OUT socket descriptor */
+	struct _sock		*sock;			/* socket pool entry of the fds */
 
 	int			debug;			/* Debug level 0-4 */
 
@@ -231,10 +245,14 @@ typedef struct _vrrp_t {
 	/* rfc2338.6.2 */
 	uint32_t		ms_down_timer;
 	timeval_t		sands;
+	unsigned		sands_index;		/* position in the sock sands heap */
 
-	/* Sending buffer */
+	/* Sending buffer, a built advert for each unicast peer */
 	char			*send_buffer;		/* Allocated send buffer */
-	int			send_buffer_size;
+	int			send_buffer_size;	/* Size of one advert */
+	int			send_buffer_count;	/* Number of adverts */
+	int			send_prio;		/* Priority in the adverts, -1 if not built */
+	bool			send_queued;		/* Adverts queued on the socket */
 
 #if defined _WITH_VRRP_AUTH_
 	/* Authentication data (only valid for VRRPv2) */
@@ -255,6 +273,13 @@ typedef struct _vrrp_t {
 	seq_counter_t		*ipsecah_counter;
 } vrrp_t;
 
+/* An advert to send, to a unicast peer or to the group if addr is NULL */
+typedef struct _vrrp_tx {
+	vrrp_t			*vrrp;
+	struct sockaddr_storage	*addr;
+	char			*buffer;
+} vrrp_tx_t;
+
 /* VRRP state machine -- rfc2338.6.4 */
 #define VRRP_STATE_INIT			0	/* rfc2338.6.4.1 */
 #define VRRP_STATE_BACK			1	/* rfc2338.6.4.2 */
@@ -287,6 +312,13 @@ typedef struct _vrrp_t {
 #define VRRP_IS_BAD_PREEMPT_DELAY(d)	((d)<0 || (d)>TIMER_MAX_SEC)
 #define VRRP_SEND_BUFFER(V)		((V)->send_buffer)
 #define VRRP_SEND_BUFFER_SIZE(V)	((V)->send_buffer_size)
+/* Adverts sent by a sendmmsg() call */
+#define VRRP_TX_BATCH			64
+
+/* Largest vrrp_tx_coalesce window, in usecs */
+#define VRRP_TX_COALESCE_MAX		(5 * TIMER_HZ / 1000)
+
+#define VRRP_SEND_BUFFER_PEER(V, I)	((V)->send_buffer + (I) * (V)->send_buffer_size)
 
 #define VRRP_TIMER_SKEW(svr)	((svr)->version == VRRP_VERSION_3 ? (((256-(svr)->base_priority) * (svr)->adver_int)/256) : ((256-(svr)->base_priority) * TIMER_HZ/256))
 #define VRRP_VIP_ISSET(V)	((V)->vipset)
@@ -309,6 +341,11 @@ extern vrrphdr_t *vrrp_get_header(sa_family_t, char *, int *);
 extern int open_vrrp_send_socket(sa_family_t, int, int, int);
 extern int open_vrrp_read_socket(sa_family_t, int, int, int);
 extern int new_vrrp_socket(vrrp_t *);
+extern void free_vrrp_vip_set(vrrp_t *);
+#ifdef _HAVE_SENDMMSG_
+extern void vrrp_send_queued(struct _sock *);
+#endif
+extern void set_vrrp_sock_filter(struct _sock *);
 extern void vrrp_send_link_update(vrrp_t *, int);
 extern int vrrp_send_adv(vrrp_t *, int);
 extern int vrrp_state_fault_rx(vrrp_t *, char *, int);
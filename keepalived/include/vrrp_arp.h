@@ -35,6 +35,7 @@
 /* local definitions */
 #define ETHERNET_HW_LEN		6
 #define IPPROTO_ADDR_LEN	4
+#define GARP_GNA_TX_BATCH	64	/* frames sent by a single sendmmsg() */
 
 /* types definition */
 typedef struct _arphdr {
@@ -55,5 +56,10 @@ typedef struct _arphdr {
 extern void gratuitous_arp_init(void);
 extern void gratuitous_arp_close(void);
 extern void send_gratuitous_arp(vrrp_t *, ip_address_t *);
-extern int send_gratuitous_arp_immediate(interface_t *, ip_address_t *);
+extern void send_gratuitous_arp_immediate(interface_t *, ip_address_t *);
+extern void build_gratuitous_arp(ip_address_t *);
+extern bool garp_gna_frame_valid(ip_address_t *);
+extern void garp_gna_queue(int, ip_address_t *);
+extern void garp_gna_send_queued(void);
+extern void garp_gna_delay(list *, timeval_t, ip_address_t *);
 #endif
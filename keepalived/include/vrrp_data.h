@@ -50,6 +50,15 @@ typedef struct _sock {
 	int			fd_in;
 	int			fd_out;
 	thread_t		*thread;
+	vrrp_t			**sands;	/* instances, min-heap by sands */
+	unsigned		sands_count;
+	unsigned		sands_size;
+#ifdef _HAVE_SENDMMSG_
+	bool			tx_queueing;	/* queue adverts for a coalesced send */
+	vrrp_tx_t		*tx;		/* queued adverts */
+	unsigned		tx_count;
+	unsigned		tx_size;
+#endif
 } sock_t;
 
 /* Configuration data root */
@@ -60,7 +69,8 @@ typedef struct _vrrp_data {
 	list			vrrp_sync_group;
 	list			vrrp;
 	list			vrrp_index;
-	list			vrrp_index_fd;
+	list			vrrp_name_index;	/* instances by name */
+	list			vrrp_sgroup_name_index;	/* sync groups by name */
 	list			vrrp_socket_pool;
 	list			vrrp_script;
 	list			vrrp_switch;
@@ -69,8 +79,15 @@ typedef struct _vrrp_data {
 /* Global Vars exported */
 extern vrrp_data_t *vrrp_data;
 extern vrrp_data_t *old_vrrp_data;
-extern char *vrrp_buffer;
-extern size_t vrrp_buffer_len;
+extern char *vrrp_buffer;		/* VRRP_RX_BATCH receive buffers */
+extern size_t vrrp_buffer_len;		/* length of each one */
+
+/* Adverts received per dispatcher recvmmsg() */
+#ifdef _HAVE_RECVMMSG_
+#define VRRP_RX_BATCH	16
+#else
+#define VRRP_RX_BATCH	1
+#endif
 
 /* prototypes */
 extern void alloc_saddress(vector_t *);
@@ -76,6 +76,9 @@ struct ethtool_value {
 /* Default values */
 #define IF_DEFAULT_BUFSIZE	(65*1024)
 
+/* Buckets of the interface hashes, by ifindex and by name */
+#define IF_HASH_SIZE		4096
+
 /* Structure for delayed sending of gratuitous ARP/NA messages */
 typedef struct _garp_delay {
 	timeval_t		garp_interval;		/* Delay between sending gratuitous ARP messages on an interface */
@@ -85,6 +88,8 @@ typedef struct _garp_delay {
 	timeval_t		garp_next_time;		/* Time when next gratuitous ARP message can be sent */
 	timeval_t		gna_next_time;		/* Time when next gratuitous NA message can be sent */
 	int			aggregation_group;	/* Index of multi-interface group */
+	list			garp_queue;		/* Addresses waiting for gratuitous ARP pacing */
+	list			gna_queue;		/* Addresses waiting for gratuitous NA pacing */
 } garp_delay_t;
 
 /* Interface structure definition */
@@ -147,10 +152,14 @@ list garp_delay;
 extern interface_t *if_get_by_ifindex(const int);
 extern interface_t *base_if_get_by_ifindex(const int);
 extern interface_t *base_if_get_by_ifp(interface_t *);
+extern interface_t *if_find_by_ifname(const char *);
 extern interface_t *if_get_by_ifname(const char *);
+extern void if_hash_add(interface_t *);
+extern void if_hash_del(interface_t *);
 extern list get_if_list(void);
 extern void reset_interface_queue(void);
 #ifdef _HAVE_VRRP_VMAC_
+extern void if_set_vmac(interface_t *, unsigned int);
 extern void if_vmac_reflect_flags(const int, const unsigned long);
 #endif
 extern int if_linkbeat(const interface_t *);
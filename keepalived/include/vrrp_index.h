@@ -32,14 +32,22 @@
 
 /* local includes */
 #include "vrrp.h"
+#include "vrrp_data.h"
 
 /* Macro definition */
+#define VRRP_NAME_INDEX_SIZE	1024	/* buckets of the name indexes, a power of 2 */
 
 /* prototypes */
 extern void alloc_vrrp_bucket(vrrp_t *);
-extern void alloc_vrrp_fd_bucket(vrrp_t *);
-extern void remove_vrrp_fd_bucket(vrrp_t *);
-extern void set_vrrp_fd_bucket(int, vrrp_t *);
 extern vrrp_t *vrrp_index_lookup(const int, const int);
+extern void alloc_vrrp_name_bucket(vrrp_t *);
+extern vrrp_t *vrrp_name_lookup(vrrp_data_t *, const char *);
+extern void alloc_vgroup_name_bucket(vrrp_sgroup_t *);
+extern void free_vgroup_name_bucket(vrrp_sgroup_t *);
+extern vrrp_sgroup_t *vrrp_sgroup_name_lookup(vrrp_data_t *, const char *);
+extern void alloc_vrrp_sock_sands(sock_t *, vrrp_t *);
+extern void update_vrrp_sock_sands(vrrp_t *);
+extern vrrp_t *vrrp_sock_sands_min(sock_t *);
+extern void set_vrrp_sock_fds(sock_t *);
 
 #endif
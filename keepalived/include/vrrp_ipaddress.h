@@ -59,6 +59,9 @@ typedef struct _ip_address {
 	bool			iptable_rule_set;	/* TRUE if iptable drop rule
 							 * set to addr */
 	bool			garp_gna_pending;	/* Is a gratuitous ARP/NA message still to be sent */
+	unsigned char		*garp_gna_frame;	/* Prebuilt gratuitous ARP/NA message */
+	int			garp_gna_frame_len;
+	unsigned int		garp_gna_ifindex;	/* Interface the message was built for */
 } ip_address_t;
 
 #define IPADDRESS_DEL 0
@@ -90,7 +90,8 @@ struct nd_opt_hdr {
 extern void ndisc_init(void);
 extern void ndisc_close(void);
 extern void ndisc_send_unsolicited_na(vrrp_t *, ip_address_t *);
-extern int ndisc_send_unsolicited_na_immediate(interface_t *, ip_address_t *);
+extern void ndisc_send_unsolicited_na_immediate(interface_t *, ip_address_t *);
+extern void ndisc_build_unsolicited_na(ip_address_t *);
 
 #endif
 
@@ -53,8 +53,39 @@ typedef struct _nl_handle {
 	uint32_t		nl_pid;
 	__u32			seq;
 	thread_t		*thread;
+	bool			overrun;	/* messages were lost */
 } nl_handle_t;
 
+/* A request sent on the command channel, waiting for its ack */
+typedef struct _nl_cmd_req {
+	__u32			seq;
+	uint16_t		type;
+	int			cmd;
+	int			error_ignore;
+	void			(*done) (void *, int, int);	/* item, cmd, error */
+	void			*item;
+	struct nlmsghdr		*n;		/* copy of an RTM_DELADDR request */
+} nl_cmd_req_t;
+
+/*
+ * A batch of requests on the command channel, sent with a single
+ * sendmsg(). The kernel queues their acks before sendmsg() returns, each
+ * taking about 1KB of receive buffer, so this also bounds the number
+ * of requests whose ack is not read yet.
+ */
+#define NETLINK_BATCH_SIZE	16384
+#define NETLINK_BATCH_MAX	64
+
+typedef struct _nl_batch {
+	void			(*done) (void *, int, int);	/* item, cmd, error */
+	int			cmd;
+	unsigned		count;
+	size_t			len;
+	void			*item[NETLINK_BATCH_MAX];
+	size_t			offset[NETLINK_BATCH_MAX];
+	char			buf[NETLINK_BATCH_SIZE];
+} nl_batch_t;
+
 /* Define types */
 #define NETLINK_TIMER (30 * TIMER_HZ)
 #ifndef _HAVE_LIBNL3_
@@ -71,6 +102,7 @@ typedef struct _nl_handle {
 /* Global vars exported */
 extern nl_handle_t nl_cmd;	/* Command channel */
 extern int netlink_error_ignore; /* If we get this error, ignore it */
+extern bool netlink_scoped;	/* Only track the configured interfaces */
 
 /* prototypes */
 extern int addattr_l(struct nlmsghdr *, size_t, int, void *, size_t);
@@ -88,7 +120,12 @@ extern size_t rta_addattr8(struct rtattr *, size_t, int, uint8_t);
 extern struct rtattr *rta_nest(struct rtattr *, size_t, int);
 extern size_t rta_nest_end(struct rtattr *, struct rtattr *);
 extern int netlink_talk(nl_handle_t *, struct nlmsghdr *);
-extern int netlink_interface_lookup(void);
+extern void netlink_cmd_complete(void);
+extern int netlink_cmd_send(struct nlmsghdr *, int, void (*) (void *, int, int), void *);
+extern void netlink_batch_init(nl_batch_t *, int, void (*) (void *, int, int));
+extern int netlink_batch_add(nl_batch_t *, struct nlmsghdr *, void *);
+extern int netlink_batch_flush(nl_batch_t *);
+extern int netlink_interface_lookup(const char *);
 extern void kernel_netlink_init(void);
 extern void kernel_netlink_close(void);
 
@@ -34,6 +34,7 @@
 #include "vrrp_sync.h"
 #include "vrrp_index.h"
 #include "vrrp_if.h"
+#include "vrrp_netlink.h"
 #ifdef _HAVE_VRRP_VMAC_
 #include "vrrp_vmac.h"
 #endif
@@ -60,6 +61,7 @@
 #endif
 
 #include <netinet/ip6.h>
+#include <linux/filter.h>
 
 /* add/remove Virtual IP addresses */
 static void
@@ -272,25 +274,151 @@ vrrp_in_chk_ipsecah(vrrp_t * vrrp, char *buffer)
 }
 #endif
 
-/* check if ipaddr is present in VIP buffer */
+/* Address of a VIP as carried in adverts */
+static void *
+vrrp_vip_addr(vrrp_t * vrrp, ip_address_t *ipaddress)
+{
+	if (vrrp->family == AF_INET)
+		return &ipaddress->u.sin.sin_addr;
+	return &ipaddress->u.sin6_addr;
+}
+
+static unsigned
+vrrp_vip_hash(vrrp_t * vrrp, const unsigned char *addr)
+{
+	uint32_t key, word;
+	size_t i;
+
+	memcpy(&key, addr, sizeof(key));
+	if (vrrp->family == AF_INET6) {
+		for (i = sizeof(key); i < sizeof(struct in6_addr); i += sizeof(word)) {
+			memcpy(&word, addr + i, sizeof(word));
+			key ^= word;
+		}
+	}
+
+	return key * 0x9e3779b1U >> 16;
+}
+
+/* Index of the first VIP with this address, or -1 */
 static int
-vrrp_in_chk_vips(vrrp_t * vrrp, ip_address_t *ipaddress, unsigned char *buffer)
+vrrp_vip_lookup(vrrp_t * vrrp, vrrp_vip_set_t *set, const unsigned char *addr, size_t addr_len)
 {
-	int i;
+	unsigned h;
+	int idx;
 
-	if (vrrp->family == AF_INET) {
-		for (i = 0; i < LIST_SIZE(vrrp->vip); i++) {
-			if (!memcmp(&ipaddress->u.sin.sin_addr.s_addr, buffer + i * sizeof(struct in_addr), sizeof (struct in_addr)))
-				return 1;
+	for (h = vrrp_vip_hash(vrrp, addr) & set->hash_mask; set->hash[h];
+	     h = (h + 1) & set->hash_mask) {
+		idx = set->hash[h] - 1;
+		if (!memcmp(vrrp_vip_addr(vrrp, set->vips[idx]), addr, addr_len))
+			return idx;
+	}
+
+	return -1;
+}
+
+/* Build the hashed set of VIPs used to check adverts */
+static void
+vrrp_alloc_vip_set(vrrp_t * vrrp)
+{
+	vrrp_vip_set_t *set;
+	size_t addr_len = (vrrp->family == AF_INET) ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+	unsigned size, h;
+	void *addr;
+	element e;
+	int i = 0;
+
+	set = (vrrp_vip_set_t *) MALLOC(sizeof(vrrp_vip_set_t));
+	set->len = LIST_SIZE(vrrp->vip) * addr_len;
+	set->vips = (ip_address_t **) MALLOC(LIST_SIZE(vrrp->vip) * sizeof(ip_address_t *));
+	set->seen = (unsigned *) MALLOC(LIST_SIZE(vrrp->vip) * sizeof(unsigned));
+	set->last = (unsigned char *) MALLOC(set->len);
+
+	for (size = 4; size < 2 * (unsigned) LIST_SIZE(vrrp->vip); size <<= 1);
+	set->hash = (int *) MALLOC(size * sizeof(int));
+	set->hash_mask = size - 1;
+
+	/* A VIP configured twice is only hashed once */
+	for (e = LIST_HEAD(vrrp->vip); e; ELEMENT_NEXT(e), i++) {
+		set->vips[i] = ELEMENT_DATA(e);
+		addr = vrrp_vip_addr(vrrp, set->vips[i]);
+		if (vrrp_vip_lookup(vrrp, set, addr, addr_len) >= 0)
+			continue;
+		for (h = vrrp_vip_hash(vrrp, addr) & set->hash_mask; set->hash[h];
+		     h = (h + 1) & set->hash_mask);
+		set->hash[h] = i + 1;
+		set->count++;
+	}
+
+	vrrp->vip_set = set;
+}
+
+void
+free_vrrp_vip_set(vrrp_t * vrrp)
+{
+	vrrp_vip_set_t *set = vrrp->vip_set;
+
+	if (!set)
+		return;
+
+	FREE(set->vips);
+	FREE(set->seen);
+	FREE(set->last);
+	FREE(set->hash);
+	FREE(set);
+	vrrp->vip_set = NULL;
+}
+
+/*
+ * Check all our VIPs are present in the address list of an advert,
+ * which has as many addresses as we have VIPs. Returns the first VIP
+ * missing, or NULL. The list last accepted from the same master is
+ * kept, so that the usual identical adverts are only compared to it.
+ */
+static ip_address_t *
+vrrp_in_chk_vips(vrrp_t * vrrp, unsigned char *buffer)
+{
+	vrrp_vip_set_t *set;
+	size_t addr_len = (vrrp->family == AF_INET) ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+	unsigned char *addr;
+	int i, idx, seen = 0;
+
+	if (!vrrp->vip_set)
+		vrrp_alloc_vip_set(vrrp);
+	set = vrrp->vip_set;
+
+	if (set->last_saddr.ss_family &&
+	    !inet_sockaddrcmp(&set->last_saddr, &vrrp->pkt_saddr) &&
+	    !memcmp(set->last, buffer, set->len))
+		return NULL;
+
+	/* A new generation marks the VIPs seen in this advert */
+	if (!++set->gen) {
+		memset(set->seen, 0, LIST_SIZE(vrrp->vip) * sizeof(unsigned));
+		set->gen = 1;
+	}
+
+	for (addr = buffer; addr < buffer + set->len; addr += addr_len) {
+		idx = vrrp_vip_lookup(vrrp, set, addr, addr_len);
+		if (idx >= 0 && set->seen[idx] != set->gen) {
+			set->seen[idx] = set->gen;
+			seen++;
 		}
-	} else if (vrrp->family == AF_INET6) {
+	}
+
+	if (seen != set->count) {
+		set->last_saddr.ss_family = 0;
 		for (i = 0; i < LIST_SIZE(vrrp->vip); i++) {
-			if (!memcmp(&ipaddress->u.sin6_addr, buffer + i * sizeof(struct in6_addr), sizeof (struct in6_addr)))
-				return 1;
+			idx = vrrp_vip_lookup(vrrp, set, vrrp_vip_addr(vrrp, set->vips[i]), addr_len);
+			if (set->seen[idx] != set->gen)
+				return set->vips[i];
 		}
 	}
 
-	return 0;
+	set->last_saddr = vrrp->pkt_saddr;
+	memcpy(set->last, buffer, set->len);
+
+	return NULL;
 }
 
 /*
@@ -582,16 +710,14 @@ vrrp_in_chk(vrrp_t * vrrp, char *buffer, size_t buflen, bool check_vip_addr)
 				 * MAY verify that the IP address(es) associated with the
 				 * VRID are valid
 				 */
-				for (e = LIST_HEAD(vrrp->vip); e; ELEMENT_NEXT(e)) {
-					ipaddress = ELEMENT_DATA(e);
-					if (!vrrp_in_chk_vips(vrrp, ipaddress, vips)) {
-						log_message(LOG_INFO, "(%s): ip address associated with VRID %d"
-						       " not present in MASTER advert : %s",
-						       vrrp->iname, vrrp->vrid,
-						       inet_ntop2(ipaddress->u.sin.sin_addr.s_addr));
-						++vrrp->stats->addr_list_err;
-						return VRRP_PACKET_KO;
-					}
+				ipaddress = vrrp_in_chk_vips(vrrp, vips);
+				if (ipaddress) {
+					log_message(LOG_INFO, "(%s): ip address associated with VRID %d"
+					       " not present in MASTER advert : %s",
+					       vrrp->iname, vrrp->vrid,
+					       inet_ntop2(ipaddress->u.sin.sin_addr.s_addr));
+					++vrrp->stats->addr_list_err;
+					return VRRP_PACKET_KO;
 				}
 			}
 
@@ -621,17 +747,15 @@ vrrp_in_chk(vrrp_t * vrrp, char *buffer, size_t buflen, bool check_vip_addr)
 					return VRRP_PACKET_KO;
 				}
 
-				for (e = LIST_HEAD(vrrp->vip); e; ELEMENT_NEXT(e)) {
-					ipaddress = ELEMENT_DATA(e);
-					if (!vrrp_in_chk_vips(vrrp, ipaddress, vips)) {
-						log_message(LOG_INFO, "(%s) ip address associated with VRID %d"
-							    " not present in MASTER advert : %s",
-							    vrrp->iname, vrrp->vrid,
-							    inet_ntop(AF_INET6, &ipaddress->u.sin6_addr,
-							    addr_str, sizeof(addr_str)));
-						++vrrp->stats->addr_list_err;
-						return VRRP_PACKET_KO;
-					}
+				ipaddress = vrrp_in_chk_vips(vrrp, vips);
+				if (ipaddress) {
+					log_message(LOG_INFO, "(%s) ip address associated with VRID %d"
+						    " not present in MASTER advert : %s",
+						    vrrp->iname, vrrp->vrid,
+						    inet_ntop(AF_INET6, &ipaddress->u.sin6_addr,
+						    addr_str, sizeof(addr_str)));
+					++vrrp->stats->addr_list_err;
+					return VRRP_PACKET_KO;
 				}
 			}
 
@@ -902,53 +1026,110 @@ vrrp_build_vrrp(vrrp_t *vrrp, int prio, char *buffer)
 
 /* build VRRP packet */
 static void
-vrrp_build_pkt(vrrp_t * vrrp, int prio, struct sockaddr_storage *addr)
+vrrp_build_pkt(vrrp_t * vrrp, int prio, struct sockaddr_storage *addr, char *buffer)
 {
-	char *bufptr;
+	char *vrrp_buffer = buffer;
 	uint32_t dst;
-	int len;
-
-	/* save reference values */
-	bufptr = VRRP_SEND_BUFFER(vrrp);
-	len = VRRP_SEND_BUFFER_SIZE(vrrp);
 
 	if (vrrp->family == AF_INET) {
 		/* build the ip header */
 		dst = (addr) ? inet_sockaddrip4(addr) :
 			       ((struct sockaddr_in *) &global_data->vrrp_mcast_group4)->sin_addr.s_addr;
-		vrrp_build_ip4(vrrp, bufptr, len, dst);
+		vrrp_build_ip4(vrrp, buffer, VRRP_SEND_BUFFER_SIZE(vrrp), dst);
 
 		/* build the vrrp header */
-		vrrp->send_buffer += vrrp_iphdr_len(vrrp);
-
+		vrrp_buffer += vrrp_iphdr_len(vrrp);
 #ifdef _WITH_VRRP_AUTH_
 		if (vrrp->auth_type == VRRP_AUTH_AH)
-			vrrp->send_buffer += vrrp_ipsecah_len();
+			vrrp_buffer += vrrp_ipsecah_len();
 #endif
-		vrrp->send_buffer_size -= vrrp_iphdr_len(vrrp);
+		vrrp_build_vrrp(vrrp, prio, vrrp_buffer);
 
 #ifdef _WITH_VRRP_AUTH_
+		/* build the IPSEC AH header */
 		if (vrrp->auth_type == VRRP_AUTH_AH)
-			vrrp->send_buffer_size -= vrrp_ipsecah_len();
+			vrrp_build_ipsecah(vrrp, buffer, VRRP_SEND_BUFFER_SIZE(vrrp));
 #endif
-		vrrp_build_vrrp(vrrp, prio, vrrp->send_buffer);
+	} else if (vrrp->family == AF_INET6) {
+		vrrp_build_vrrp(vrrp, prio, buffer);
+	}
+}
+
+/* Give a built IPv4 advert the next IP id */
+static void
+vrrp_update_ip_id(vrrp_t * vrrp, struct iphdr *ip)
+{
+	u_short old = ip->id;
+
+	ip->id = htons(++vrrp->ip_id);
+	if (vrrp->ip_id == 65535)
+		vrrp->ip_id = 1;
+	ip->check = in_csum_update(ip->check, old, ip->id);
+}
+
+/*
+ * Build the advert to a unicast peer from the one built for the
+ * first peer. They only differ by the IP destination and id, the
+ * VRRP checksum doesn't cover the destination.
+ */
+static void
+vrrp_build_peer_pkt(vrrp_t * vrrp, int prio, struct sockaddr_storage *addr, char *buffer)
+{
+	struct iphdr *ip = (struct iphdr *) buffer;
+	u_short *old, *new;
+	uint32_t daddr;
 
 #ifdef _WITH_VRRP_AUTH_
-		/* build the IPSEC AH header */
-		if (vrrp->auth_type == VRRP_AUTH_AH) {
-			vrrp->send_buffer_size += vrrp_iphdr_len(vrrp) + vrrp_ipsecah_len();
-			vrrp_build_ipsecah(vrrp, bufptr, VRRP_SEND_BUFFER_SIZE(vrrp));
-		}
-#endif
-	} else if (vrrp->family == AF_INET6) {
-		vrrp_build_vrrp(vrrp, prio, VRRP_SEND_BUFFER(vrrp));
+	/* the ICV covers the destination */
+	if (vrrp->auth_type == VRRP_AUTH_AH) {
+		vrrp_build_pkt(vrrp, prio, addr, buffer);
+		return;
 	}
+#endif
+
+	memcpy(buffer, VRRP_SEND_BUFFER(vrrp), VRRP_SEND_BUFFER_SIZE(vrrp));
+	if (vrrp->family != AF_INET)
+		return;
+
+	daddr = ip->daddr;
+	ip->daddr = inet_sockaddrip4(addr);
+	old = (u_short *) &daddr;
+	new = (u_short *) &ip->daddr;
+	ip->check = in_csum_update(ip->check, old[0], new[0]);
+	ip->check = in_csum_update(ip->check, old[1], new[1]);
+	vrrp_update_ip_id(vrrp, ip);
+}
+
+/*
+ * Update a built advert for the next send. Only the IP id changes,
+ * and the priority if it changed since the advert was built, so
+ * both checksums are updated incrementally.
+ */
+static void
+vrrp_update_pkt(vrrp_t * vrrp, int prio, char *buffer)
+{
+	vrrphdr_t *hd;
+	u_short old;
 
-	/* restore reference values */
-	vrrp->send_buffer = bufptr;
-	vrrp->send_buffer_size = len;
+	if (vrrp->family == AF_INET) {
+		vrrp_update_ip_id(vrrp, (struct iphdr *) buffer);
+		hd = (vrrphdr_t *) (buffer + vrrp_iphdr_len(vrrp));
+	} else
+		hd = (vrrphdr_t *) buffer;
+
+	if (prio == vrrp->send_prio)
+		return;
+
+	/* priority shares its checksum word with naddr */
+	old = *(u_short *) &hd->priority;
+	hd->priority = prio;
+	if (vrrp->family == AF_INET)
+		hd->chksum = in_csum_update(hd->chksum, old, *(u_short *) &hd->priority);
 }
 
+/* Ancillary data of an advert, the IPv6 source */
+#define VRRP_CMSG_SIZE	CMSG_SPACE(sizeof(struct in6_pktinfo))
+
 /* send VRRP packet */
 static int
 vrrp_build_ancillary_data(struct msghdr *msg, char *cbuf, struct sockaddr_storage *src)
@@ -960,7 +1141,7 @@ vrrp_build_ancillary_data(struct msghdr *msg, char *cbuf, struct sockaddr_storag
 		return -1;
 
 	msg->msg_control = cbuf;
-	msg->msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
+	msg->msg_controllen = VRRP_CMSG_SIZE;
 
 	cmsg = CMSG_FIRSTHDR(msg);
 	cmsg->cmsg_level = IPPROTO_IPV6;
@@ -975,51 +1156,166 @@ vrrp_build_ancillary_data(struct msghdr *msg, char *cbuf, struct sockaddr_storag
 	return 0;
 }
 
+/* Fill in the message for an advert, to a unicast peer or to the group */
+static void
+vrrp_build_msg(vrrp_t * vrrp, struct sockaddr_storage *addr, char *buffer,
+	       struct msghdr *msg, struct iovec *iov, char *cbuf,
+	       struct sockaddr_storage *dst)
+{
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_iov = iov;
+	msg->msg_iovlen = 1;
+	iov->iov_base = buffer;
+	iov->iov_len = VRRP_SEND_BUFFER_SIZE(vrrp);
+
+	/* Multicast sending path */
+	if (!addr) {
+		memset(dst, 0, sizeof(*dst));
+		dst->ss_family = vrrp->family;
+		if (vrrp->family == AF_INET)
+			((struct sockaddr_in *) dst)->sin_addr =
+				((struct sockaddr_in *) &global_data->vrrp_mcast_group4)->sin_addr;
+		else
+			((struct sockaddr_in6 *) dst)->sin6_addr =
+				((struct sockaddr_in6 *) &global_data->vrrp_mcast_group6)->sin6_addr;
+		addr = dst;
+	}
+
+	msg->msg_name = addr;
+	if (addr->ss_family == AF_INET)
+		msg->msg_namelen = sizeof(struct sockaddr_in);
+	else {
+		msg->msg_namelen = sizeof(struct sockaddr_in6);
+		vrrp_build_ancillary_data(msg, cbuf, &vrrp->saddr);
+	}
+}
+
 static int
-vrrp_send_pkt(vrrp_t * vrrp, struct sockaddr_storage *addr)
+vrrp_send_pkt(vrrp_t * vrrp, struct sockaddr_storage *addr, char *buffer)
 {
-	struct sockaddr_storage *src = &vrrp->saddr;
-	struct sockaddr_in6 dst6;
-	struct sockaddr_in dst4;
+	struct sockaddr_storage dst;
 	struct msghdr msg;
 	struct iovec iov;
-	char cbuf[256];
-
-	/* Build the message data */
-	memset(&msg, 0, sizeof(msg));
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
-	iov.iov_base = VRRP_SEND_BUFFER(vrrp);
-	iov.iov_len = VRRP_SEND_BUFFER_SIZE(vrrp);
-
-	/* Unicast sending path */
-	if (addr && addr->ss_family == AF_INET) {
-		msg.msg_name = (struct sockaddr_in *) addr;
-		msg.msg_namelen = sizeof(struct sockaddr_in);
-	} else if (addr && addr->ss_family == AF_INET6) {
-		msg.msg_name = (struct sockaddr_in6 *) addr;
-		msg.msg_namelen = sizeof(struct sockaddr_in6);
-		vrrp_build_ancillary_data(&msg, cbuf, src);
-	} else if (vrrp->family == AF_INET) { /* Multicast sending path */
-		memset(&dst4, 0, sizeof(dst4));
-		dst4.sin_family = AF_INET;
-		dst4.sin_addr = ((struct sockaddr_in *) &global_data->vrrp_mcast_group4)->sin_addr;
-		msg.msg_name = &dst4;
-		msg.msg_namelen = sizeof(dst4);
-	} else if (vrrp->family == AF_INET6) {
-		memset(&dst6, 0, sizeof(dst6));
-		dst6.sin6_family = AF_INET6;
-		dst6.sin6_addr = ((struct sockaddr_in6 *) &global_data->vrrp_mcast_group6)->sin6_addr;
-		msg.msg_name = &dst6;
-		msg.msg_namelen = sizeof(dst6);
-		vrrp_build_ancillary_data(&msg, cbuf, src);
-	}
+	char cbuf[VRRP_CMSG_SIZE];
+
+	vrrp_build_msg(vrrp, addr, buffer, &msg, &iov, cbuf, &dst);
 
 	/* Send the packet */
 	return sendmsg(vrrp->fd_out, &msg, (addr) ? 0 : MSG_DONTROUTE);
 }
 
-/* Allocate the sending buffer */
+/* Report a failed advert, multicast failures are only counted */
+static void
+vrrp_send_err(vrrp_t * vrrp, struct sockaddr_storage *addr)
+{
+	if (addr)
+		log_message(LOG_INFO, "VRRP_Instance(%s) Cant send advert to %s (%m)"
+				    , vrrp->iname, inet_sockaddrtos(addr));
+	++vrrp->stats->advert_send_err;
+}
+
+#ifdef _HAVE_SENDMMSG_
+/* Send built adverts, which all go either to unicast peers or to the group */
+static void
+vrrp_sendmmsg(int fd, vrrp_tx_t *tx, int count)
+{
+	struct mmsghdr msgs[VRRP_TX_BATCH];
+	struct iovec iovs[VRRP_TX_BATCH];
+	struct sockaddr_storage dsts[VRRP_TX_BATCH];
+	char cbufs[VRRP_TX_BATCH][VRRP_CMSG_SIZE];
+	int flags = (tx->addr) ? 0 : MSG_DONTROUTE;
+	int i, n, sent, ret;
+
+	for (; count > 0; count -= n, tx += n) {
+		n = (count < VRRP_TX_BATCH) ? count : VRRP_TX_BATCH;
+		for (i = 0; i < n; i++)
+			vrrp_build_msg(tx[i].vrrp, tx[i].addr, tx[i].buffer,
+				       &msgs[i].msg_hdr, &iovs[i], cbufs[i], &dsts[i]);
+
+		/* sendmmsg() stops at the first failed advert, report it and go on */
+		for (sent = 0; sent < n; sent += ret) {
+			ret = sendmmsg(fd, &msgs[sent], n - sent, flags);
+			if (ret <= 0) {
+				vrrp_send_err(tx[sent].vrrp, tx[sent].addr);
+				ret = 1;
+			}
+		}
+	}
+}
+
+/* Queue an advert on the socket, to go out with the other coalesced adverts */
+static void
+vrrp_queue_pkt(vrrp_t * vrrp, struct sockaddr_storage *addr, char *buffer)
+{
+	sock_t *sock = vrrp->sock;
+	vrrp_tx_t *tx;
+
+	if (sock->tx_count == sock->tx_size) {
+		sock->tx_size = (sock->tx_size) ? sock->tx_size * 2 : VRRP_TX_BATCH;
+		sock->tx = (sock->tx) ? REALLOC(sock->tx, sock->tx_size * sizeof(vrrp_tx_t)) :
+					MALLOC(sock->tx_size * sizeof(vrrp_tx_t));
+	}
+
+	tx = &sock->tx[sock->tx_count++];
+	tx->vrrp = vrrp;
+	tx->addr = addr;
+	tx->buffer = buffer;
+	vrrp->send_queued = true;
+}
+
+/* Send the adverts queued on a socket */
+void
+vrrp_send_queued(sock_t *sock)
+{
+	unsigned i;
+
+	if (!sock->tx_count)
+		return;
+
+	vrrp_sendmmsg(sock->fd_out, sock->tx, sock->tx_count);
+	for (i = 0; i < sock->tx_count; i++)
+		sock->tx[i].vrrp->send_queued = false;
+	sock->tx_count = 0;
+}
+
+/* Send the built adverts to the unicast peers */
+static void
+vrrp_send_unicast(vrrp_t * vrrp)
+{
+	vrrp_tx_t tx[VRRP_TX_BATCH];
+	element e;
+	int i = 0, n = 0;
+
+	for (e = LIST_HEAD(vrrp->unicast_peer); e; ELEMENT_NEXT(e), i++) {
+		tx[n].vrrp = vrrp;
+		tx[n].addr = ELEMENT_DATA(e);
+		tx[n].buffer = VRRP_SEND_BUFFER_PEER(vrrp, i);
+		if (++n == VRRP_TX_BATCH) {
+			vrrp_sendmmsg(vrrp->fd_out, tx, n);
+			n = 0;
+		}
+	}
+	if (n)
+		vrrp_sendmmsg(vrrp->fd_out, tx, n);
+}
+#else
+/* Send the built adverts to the unicast peers */
+static void
+vrrp_send_unicast(vrrp_t * vrrp)
+{
+	struct sockaddr_storage *addr;
+	element e;
+	int i = 0;
+
+	for (e = LIST_HEAD(vrrp->unicast_peer); e; ELEMENT_NEXT(e), i++) {
+		addr = ELEMENT_DATA(e);
+		if (vrrp_send_pkt(vrrp, addr, VRRP_SEND_BUFFER_PEER(vrrp, i)) < 0)
+			vrrp_send_err(vrrp, addr);
+	}
+}
+#endif
+
+/* Allocate the sending buffer, room for an advert to each peer */
 static void
 vrrp_alloc_send_buffer(vrrp_t * vrrp)
 {
@@ -1033,39 +1329,93 @@ vrrp_alloc_send_buffer(vrrp_t * vrrp)
 #endif
 	}
 
-	vrrp->send_buffer = MALLOC(VRRP_SEND_BUFFER_SIZE(vrrp));
+	vrrp->send_buffer_count = (!LIST_ISEMPTY(vrrp->unicast_peer)) ?
+				  LIST_SIZE(vrrp->unicast_peer) : 1;
+	vrrp->send_buffer = MALLOC(vrrp->send_buffer_count * VRRP_SEND_BUFFER_SIZE(vrrp));
+	vrrp->send_prio = -1;
+}
+
+/*
+ * The adverts are built once and then only updated, unless they
+ * depend on something that may have changed: the source address
+ * taken from the interface, or the AH sequence number and ICV.
+ */
+static bool
+vrrp_send_buffer_valid(vrrp_t * vrrp)
+{
+	if (vrrp->send_prio < 0)
+		return false;
+
+	if (vrrp->family != AF_INET)
+		return true;
+
+#ifdef _WITH_VRRP_AUTH_
+	if (vrrp->auth_type == VRRP_AUTH_AH)
+		return false;
+#endif
+
+	return ((struct iphdr *) VRRP_SEND_BUFFER(vrrp))->saddr == VRRP_PKT_SADDR(vrrp);
 }
 
 /* send VRRP advertisement */
 int
 vrrp_send_adv(vrrp_t * vrrp, int prio)
 {
-	struct sockaddr_storage *addr;
 	list l = vrrp->unicast_peer;
+	bool valid;
 	element e;
-	int ret;
+	char *buffer;
+	int i;
 
 	/* alloc send buffer */
 	if (!vrrp->send_buffer)
 		vrrp_alloc_send_buffer(vrrp);
-	else
-		memset(vrrp->send_buffer, 0, VRRP_SEND_BUFFER_SIZE(vrrp));
 
-	/* build the packet */
+#ifdef _HAVE_SENDMMSG_
+	/* the queued adverts are updated in place, send them first */
+	if (vrrp->send_queued)
+		vrrp_send_queued(vrrp->sock);
+#endif
+
+	valid = vrrp_send_buffer_valid(vrrp);
+	if (!valid)
+		memset(vrrp->send_buffer, 0, vrrp->send_buffer_count * VRRP_SEND_BUFFER_SIZE(vrrp));
+
+	/* build or update the packets, and send them */
 	if (!LIST_ISEMPTY(l)) {
-		for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-			addr = ELEMENT_DATA(e);
-			vrrp_build_pkt(vrrp, prio, addr);
-			ret = vrrp_send_pkt(vrrp, addr);
-			if (ret < 0) {
-				log_message(LOG_INFO, "VRRP_Instance(%s) Cant send advert to %s (%m)"
-						    , vrrp->iname, inet_sockaddrtos(addr));
-			}
+		for (e = LIST_HEAD(l), i = 0; e; ELEMENT_NEXT(e), i++) {
+			buffer = VRRP_SEND_BUFFER_PEER(vrrp, i);
+			if (valid)
+				vrrp_update_pkt(vrrp, prio, buffer);
+			else if (i)
+				vrrp_build_peer_pkt(vrrp, prio, ELEMENT_DATA(e), buffer);
+			else
+				vrrp_build_pkt(vrrp, prio, ELEMENT_DATA(e), buffer);
 		}
+#ifdef _HAVE_SENDMMSG_
+		if (vrrp->sock && vrrp->sock->tx_queueing) {
+			for (e = LIST_HEAD(l), i = 0; e; ELEMENT_NEXT(e), i++)
+				vrrp_queue_pkt(vrrp, ELEMENT_DATA(e), VRRP_SEND_BUFFER_PEER(vrrp, i));
+		} else
+#endif
+			vrrp_send_unicast(vrrp);
 	} else {
-		vrrp_build_pkt(vrrp, prio, NULL);
-		vrrp_send_pkt(vrrp, NULL);
+		buffer = VRRP_SEND_BUFFER(vrrp);
+		if (valid)
+			vrrp_update_pkt(vrrp, prio, buffer);
+		else
+			vrrp_build_pkt(vrrp, prio, NULL, buffer);
+#ifdef _HAVE_SENDMMSG_
+		if (vrrp->sock && vrrp->sock->tx_queueing)
+			vrrp_queue_pkt(vrrp, NULL, buffer);
+		else if (vrrp_send_pkt(vrrp, NULL, buffer) < 0)
+			vrrp_send_err(vrrp, NULL);
+#else
+		if (vrrp_send_pkt(vrrp, NULL, buffer) < 0)
+			vrrp_send_err(vrrp, NULL);
+#endif
 	}
+	vrrp->send_prio = prio;
 
 	++vrrp->stats->advert_sent;
 	/* sent it */
@@ -1148,6 +1498,32 @@ vrrp_send_link_update(vrrp_t * vrrp, int rep)
 			}
 		}
 	}
+
+	garp_gna_send_queued();
+}
+
+/* Prebuild the gratuitous ARP/NA messages of the VIPs, now they are set */
+static void
+vrrp_build_link_update(vrrp_t * vrrp)
+{
+	ip_address_t *ipaddress;
+	element e;
+	list l;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		l = (i == 0) ? vrrp->vip : vrrp->evip;
+		if (LIST_ISEMPTY(l))
+			continue;
+
+		for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+			ipaddress = ELEMENT_DATA(e);
+			if (!IP_IS6(ipaddress))
+				build_gratuitous_arp(ipaddress);
+			else
+				ndisc_build_unsolicited_na(ipaddress);
+		}
+	}
 }
 
 static void
@@ -1169,8 +1545,6 @@ vrrp_remove_delayed_arp(vrrp_t *vrrp)
 			ipaddress->garp_gna_pending = false;
 		}
 	}
-	vrrp->garp_pending = false;
-	vrrp->gna_pending = false;
 }
 
 /* becoming master */
@@ -1190,6 +1564,7 @@ vrrp_state_become_master(vrrp_t * vrrp)
 	if (!LIST_ISEMPTY(vrrp->evip))
 		vrrp_handle_ipaddress(vrrp, IPADDRESS_ADD, VRRP_EVIP_TYPE);
 	vrrp->vipset = 1;
+	vrrp_build_link_update(vrrp);
 
 #ifdef _HAVE_FIB_ROUTING_
 	/* add virtual routes */
@@ -1743,6 +2118,147 @@ open_vrrp_read_socket(sa_family_t family, int proto, int idx,
 	return fd;
 }
 
+#ifdef SO_ATTACH_FILTER
+/* Largest filter we build, leaving room for 255 VRIDs */
+#define VRRP_FILTER_MAX		(BPF_MAXINSNS - 300)
+
+static void
+vrrp_filter_add(struct sock_filter *filter, unsigned *len,
+		uint16_t code, uint8_t jt, uint8_t jf, uint32_t k)
+{
+	struct sock_filter *insn = &filter[(*len)++];
+
+	insn->code = code;
+	insn->jt = jt;
+	insn->jf = jf;
+	insn->k = k;
+}
+
+/* Append the unicast peer source checks, returning the ja to patch */
+static unsigned
+vrrp_filter_add_peer(struct sock_filter *filter, unsigned *len,
+		     struct sockaddr_storage *peer)
+{
+	uint32_t *addr6;
+	int i;
+
+	if (peer->ss_family == AF_INET) {
+		vrrp_filter_add(filter, len, BPF_JMP | BPF_JEQ | BPF_K, 0, 1,
+				ntohl(((struct sockaddr_in *) peer)->sin_addr.s_addr));
+	} else {
+		/* IPv6 raw sockets see the packet from the VRRP header */
+		addr6 = ((struct sockaddr_in6 *) peer)->sin6_addr.s6_addr32;
+		for (i = 0; i < 4; i++) {
+			vrrp_filter_add(filter, len, BPF_LD | BPF_W | BPF_ABS, 0, 0,
+					SKF_NET_OFF + offsetof(struct ip6_hdr, ip6_src) + 4 * i);
+			vrrp_filter_add(filter, len, BPF_JMP | BPF_JEQ | BPF_K, 0,
+					2 * (3 - i) + 1, ntohl(addr6[i]));
+		}
+	}
+	vrrp_filter_add(filter, len, BPF_JMP | BPF_JA, 0, 0, 0);
+
+	return *len - 1;
+}
+#endif
+
+/*
+ * Attach a socket filter to a pool read socket so that only adverts
+ * for the VRIDs of the instances using it, and when unicast sources
+ * are checked only adverts from their peers, are queued to us. On a
+ * shared segment the adverts of the other routers are then dropped
+ * by the kernel instead of waking us up.
+ */
+void
+set_vrrp_sock_filter(sock_t *sock)
+{
+#ifdef SO_ATTACH_FILTER
+	struct sock_filter *filter;
+	struct sock_fprog prog;
+	bool vrids[256] = { false };
+	unsigned len = 0, npeers = 0, nvrids = 0;
+	unsigned *jumps = NULL, njumps = 0;
+	unsigned size, i, j;
+	bool check_src;
+	vrrp_t *vrrp;
+	element e;
+
+	if (sock->fd_in < 0 || !sock->sands_count)
+		return;
+
+	for (i = 0; i < sock->sands_count; i++) {
+		vrrp = sock->sands[i];
+		if (!vrids[vrrp->vrid]) {
+			vrids[vrrp->vrid] = true;
+			nvrids++;
+		}
+		if (sock->unicast)
+			npeers += LIST_SIZE(vrrp->unicast_peer);
+	}
+
+	/* Mirror the unicast source check of vrrp_in_chk() */
+	check_src = sock->unicast && global_data->vrrp_check_unicast_src;
+	if (check_src && 9 * npeers > VRRP_FILTER_MAX) {
+		log_message(LOG_INFO, "Too many unicast peers on fd %d to filter"
+				      " their sources", sock->fd_in);
+		check_src = false;
+	}
+	if (!check_src)
+		npeers = 0;
+
+	size = 9 * npeers + nvrids + 5;
+	filter = (struct sock_filter *) MALLOC(size * sizeof(struct sock_filter));
+	if (npeers)
+		jumps = (unsigned *) MALLOC(npeers * sizeof(unsigned));
+
+	/* IPv4 raw sockets see the IP header, X = its length */
+	if (sock->family == AF_INET)
+		vrrp_filter_add(filter, &len, BPF_LDX | BPF_B | BPF_MSH, 0, 0, 0);
+
+	if (npeers) {
+		if (sock->family == AF_INET)
+			vrrp_filter_add(filter, &len, BPF_LD | BPF_W | BPF_ABS, 0, 0,
+					offsetof(struct iphdr, saddr));
+		for (i = 0; i < sock->sands_count; i++) {
+			vrrp = sock->sands[i];
+			for (e = LIST_HEAD(vrrp->unicast_peer); e; ELEMENT_NEXT(e))
+				jumps[njumps++] = vrrp_filter_add_peer(filter, &len,
+								       ELEMENT_DATA(e));
+		}
+		vrrp_filter_add(filter, &len, BPF_RET | BPF_K, 0, 0, 0);
+
+		for (i = 0; i < njumps; i++)
+			filter[jumps[i]].k = len - jumps[i] - 1;
+		FREE(jumps);
+	}
+
+	/* Load the VRID, past the AH header for IPSEC-AH */
+	if (sock->family == AF_INET)
+		vrrp_filter_add(filter, &len, BPF_LD | BPF_B | BPF_IND, 0, 0,
+				((sock->proto == IPPROTO_IPSEC_AH) ? sizeof(ipsec_ah_t) : 0) +
+				offsetof(vrrphdr_t, vrid));
+	else
+		vrrp_filter_add(filter, &len, BPF_LD | BPF_B | BPF_ABS, 0, 0,
+				offsetof(vrrphdr_t, vrid));
+
+	for (i = 0, j = 0; i < 256; i++) {
+		if (!vrids[i])
+			continue;
+		vrrp_filter_add(filter, &len, BPF_JMP | BPF_JEQ | BPF_K,
+				nvrids - j++, 0, i);
+	}
+	vrrp_filter_add(filter, &len, BPF_RET | BPF_K, 0, 0, 0);
+	vrrp_filter_add(filter, &len, BPF_RET | BPF_K, 0, 0, 0xffffffff);
+
+	prog.len = len;
+	prog.filter = filter;
+	if (setsockopt(sock->fd_in, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0)
+		log_message(LOG_INFO, "cant set socket filter on fd %d. errno=%d (%m)",
+			    sock->fd_in, errno);
+
+	FREE(filter);
+#endif
+}
+
 static void
 close_vrrp_socket(vrrp_t * vrrp)
 {
@@ -1756,12 +2272,16 @@ close_vrrp_socket(vrrp_t * vrrp)
 int
 new_vrrp_socket(vrrp_t * vrrp)
 {
-	int old_fd = vrrp->fd_in;
 	int proto, ifindex, unicast;
 
+	/* The dispatcher registration goes with the fd, it is made again */
+	if (vrrp->sock) {
+		thread_cancel(vrrp->sock->thread);
+		vrrp->sock->thread = NULL;
+	}
+
 	/* close the desc & open a new one */
 	close_vrrp_socket(vrrp);
-	remove_vrrp_fd_bucket(vrrp);
 #ifdef _WITH_VRRP_AUTH_
 	if (vrrp->version == VRRP_VERSION_2)
 		proto =(vrrp->auth_type == VRRP_AUTH_AH) ? IPPROTO_IPSEC_AH :
@@ -1777,10 +2297,14 @@ new_vrrp_socket(vrrp_t * vrrp)
 	unicast = !LIST_ISEMPTY(vrrp->unicast_peer);
 	vrrp->fd_in = open_vrrp_read_socket(vrrp->family, proto, ifindex, unicast);
 	vrrp->fd_out = open_vrrp_send_socket(vrrp->family, proto, ifindex, unicast);
-	alloc_vrrp_fd_bucket(vrrp);
 
-	/* Sync the other desc */
-	set_vrrp_fd_bucket(old_fd, vrrp);
+	/* Sync the socket pool entry and the other instances using it */
+	if (vrrp->sock) {
+		vrrp->sock->fd_in = vrrp->fd_in;
+		vrrp->sock->fd_out = vrrp->fd_out;
+		set_vrrp_sock_fds(vrrp->sock);
+		set_vrrp_sock_filter(vrrp->sock);
+	}
 
 	return vrrp->fd_in;
 }
@@ -1840,6 +2364,27 @@ shutdown_vrrp_instances(void)
 	}
 }
 
+#ifdef _HAVE_VRRP_VMAC_
+/* Next default VMAC name to try, after vrrp.<vrid> */
+static void
+vmac_next_ifname(const vrrp_t *vrrp, int *num, char *ifname)
+{
+	/* For IPv6 try vrrp6 as second attempt */
+	if (vrrp->family == AF_INET6) {
+		if (*num == 0)
+			*num = 6;
+		else if (*num == 6)
+			*num = 1;
+		else if (++*num == 6)
+			(*num)++;
+	}
+	else
+		(*num)++;
+
+	snprintf(ifname, IFNAMSIZ, "vrrp%d.%d", *num, vrrp->vrid);
+}
+#endif
+
 /* complete vrrp structure */
 static int
 vrrp_complete_instance(vrrp_t * vrrp)
@@ -2047,6 +2592,16 @@ vrrp_complete_instance(vrrp_t * vrrp)
 		/* The same vrid can be used for both IPv4 and IPv6, and also on multiple underlying
 		 * interfaces. */
 
+		/* When tracking is scoped, only the configured interfaces are
+		 * known, so fetch any existing VMACs with the default names */
+		if (netlink_scoped && !vrrp->vmac_ifname[0]) {
+			int num = 0;
+
+			snprintf(ifname, IFNAMSIZ, "vrrp.%d", vrrp->vrid);
+			while (if_get_by_ifname(ifname))
+				vmac_next_ifname(vrrp, &num, ifname);
+		}
+
 		/* Look to see if an existing interface matches. If so, use that name */
 		list if_list = get_if_list();
 		if (!LIST_ISEMPTY(if_list)) {		/* If the list were empty we would have a real problem! */
@@ -2095,19 +2650,7 @@ vrrp_complete_instance(vrrp_t * vrrp)
 				if (!e && !if_get_by_ifname(ifname))
 					break;
 
-				/* For IPv6 try vrrp6 as second attempt */
-				if (vrrp->family == AF_INET6) {
-					if (num == 0)
-						num = 6;
-					else if (num == 6)
-						num = 1;
-					else if (++num == 6)
-						num++;
-				}
-				else
-					num++;
-
-				snprintf(ifname, IFNAMSIZ, "vrrp%d.%d", num, vrrp->vrid);
+				vmac_next_ifname(vrrp, &num, ifname);
 			}
 
 			/* We've found a unique name */
@@ -2240,15 +2783,13 @@ vrrp_complete_init(void)
 {
 	/*
 	 * l - List of VRRP instances to complete
-	 * ol- List of VRRP sync-groups to restore state
 	 * sl- List of VRRP instances within a sync-group
 	 *
 	 * e - Element equal to a specific VRRP instance
-	 * eo- Element equal to a specific group within old global group list
 	 * se- Element equal to a specific VRRP instance within sync group
 	 */
-	list l, ol, sl;
-	element e, oe, se;
+	list l, sl;
+	element e, se;
 	vrrp_t *vrrp;
 	vrrp_sgroup_t *sgroup, *old_sgroup;
 	list l_o;
@@ -2328,100 +2869,88 @@ vrrp_complete_init(void)
 		vrrp_sync_set_group(sgroup);
 		if (LIST_ISEMPTY(sgroup->index_list) ||
 			LIST_SIZE(sgroup->index_list) <= 1) {
+			free_vgroup_name_bucket(sgroup);
 			free_list_element(vrrp_data->vrrp_sync_group, e);
 			continue;
 		}
 
-		if (reload) {
-			ol = old_vrrp_data->vrrp_sync_group;
-			for (oe = LIST_HEAD(ol); oe; ELEMENT_NEXT(oe)) {
-				old_sgroup = ELEMENT_DATA(oe);
+		/* Restore the state of the sync group before the reload */
+		if (reload &&
+		    (old_sgroup = vrrp_sgroup_name_lookup(old_vrrp_data, sgroup->gname))) {
+			log_message(LOG_INFO,
+				"VRRP_Group(%s) - Found saved old sync-group called %s",
+				GROUP_NAME(sgroup), GROUP_NAME(old_sgroup));
+
+			/* Check for instances that have been removed from the
+			 * sync-group. If this is the case, and the sync-group
+			 * was previously in the MASTER state, then we should
+			 * fall-back to BACKUP, to allow a new MASTER
+			 * for any removed instances.
+			 */
+			if (LIST_SIZE(sgroup->index_list) <
+				LIST_SIZE(old_sgroup->index_list)) {
+				sgroup->state = VRRP_STATE_BACK;
+				log_message(LOG_INFO,
+					"VRRP_Group(%s) Detected instance removed from sync-group, forcing BACKUP",
+					GROUP_NAME(sgroup));
+			} else {
+				sgroup->state = old_sgroup->state;
+			}
+
+			log_message(LOG_INFO,
+				"VRRP_Group(%s) Restoring saved sync State : %d",
+				GROUP_NAME(sgroup), sgroup->state);
+
+			sl = sgroup->index_list;
+			for (se = LIST_HEAD(sl); se; ELEMENT_NEXT(se)) {
+				vrrp = ELEMENT_DATA(se);
 				log_message(LOG_INFO,
-					"VRRP_Group(%s) - Found saved old sync-group called %s",
-					GROUP_NAME(sgroup), GROUP_NAME(old_sgroup));
-
-				if (strcmp(old_sgroup->gname, sgroup->gname) == 0) {
-					/* Old Sync group matches current Sync group */
-
-					/* Check for instances that have been removed from the
-					 * sync-group. If this is the case, and the sync-group
-					 * was previously in the MASTER state, then we should
-					 * fall-back to BACKUP, to allow a new MASTER
-					 * for any removed instances.
-					 */
-					if (LIST_SIZE(sgroup->index_list) <
-						LIST_SIZE(old_sgroup->index_list)) {
-						sgroup->state = VRRP_STATE_BACK;
-						log_message(LOG_INFO,
-							"VRRP_Group(%s) Detected instance removed from sync-group, forcing BACKUP",
-							GROUP_NAME(sgroup));
-					} else {
-						sgroup->state = old_sgroup->state;
+					"VRRP_Instance(%s) used for VRRP_Group(%s) refresh sync",
+					vrrp->iname, GROUP_NAME(sgroup));
+
+				switch (sgroup->state) {
+				case VRRP_STATE_INIT:
+					/* Do nothing */
+					break;
+
+				case VRRP_STATE_BACK:
+					if (vrrp->state != VRRP_STATE_BACK) {
+						vrrp->wantstate = VRRP_STATE_BACK;
 					}
+					break;
 
-					log_message(LOG_INFO,
-						"VRRP_Group(%s) Restoring saved sync State : %d",
-						GROUP_NAME(sgroup), sgroup->state);
-
-					sl = sgroup->index_list;
-					for (se = LIST_HEAD(sl); se; ELEMENT_NEXT(se)) {
-						vrrp = ELEMENT_DATA(se);
-						log_message(LOG_INFO,
-							"VRRP_Instance(%s) used for VRRP_Group(%s) refresh sync",
-							vrrp->iname, GROUP_NAME(sgroup));
-
-						switch (sgroup->state) {
-						case VRRP_STATE_INIT:
-							/* Do nothing */
-							break;
-
-						case VRRP_STATE_BACK:
-							if (vrrp->state != VRRP_STATE_BACK) {
-								vrrp->wantstate = VRRP_STATE_BACK;
-							}
-							break;
-
-						case VRRP_STATE_MAST:
-							if (vrrp->state != VRRP_STATE_MAST) {
-								vrrp->wantstate = VRRP_STATE_MAST;
-							}
-							break;
-
-						case VRRP_STATE_FAULT:
-							if (vrrp->state != VRRP_STATE_FAULT) {
-								if (vrrp->state == VRRP_STATE_MAST)
-									vrrp->wantstate = VRRP_STATE_GOTO_FAULT;
-								if (vrrp->state == VRRP_STATE_BACK)
-									vrrp->state = VRRP_STATE_FAULT;
-							}
-							break;
-
-						default:
-							/* Do nothing */
-							break;
-						}
+				case VRRP_STATE_MAST:
+					if (vrrp->state != VRRP_STATE_MAST) {
+						vrrp->wantstate = VRRP_STATE_MAST;
 					}
+					break;
 
-					notify_group_exec(sgroup, sgroup->state);
-#ifdef _WITH_SNMP_KEEPALIVED_
-					vrrp_snmp_group_trap(sgroup);
-#endif
+				case VRRP_STATE_FAULT:
+					if (vrrp->state != VRRP_STATE_FAULT) {
+						if (vrrp->state == VRRP_STATE_MAST)
+							vrrp->wantstate = VRRP_STATE_GOTO_FAULT;
+						if (vrrp->state == VRRP_STATE_BACK)
+							vrrp->state = VRRP_STATE_FAULT;
+					}
+					break;
+
+				default:
+					/* Do nothing */
+					break;
 				}
 			}
+
+			notify_group_exec(sgroup, sgroup->state);
+#ifdef _WITH_SNMP_KEEPALIVED_
+			vrrp_snmp_group_trap(sgroup);
+#endif
 		}
 	}
 
 #ifdef _HAVE_IPVS_SYNCD_
 	/* Set up the lvs_syncd vrrp */
 	if (global_data->lvs_syncd.vrrp_name) {
-		for (e = LIST_HEAD(vrrp_data->vrrp); e; ELEMENT_NEXT(e)) {
-			vrrp = ELEMENT_DATA(e);
-			if (!strcmp(global_data->lvs_syncd.vrrp_name, vrrp->iname)) {
-				global_data->lvs_syncd.vrrp = vrrp;
-
-				break;
-			}
-		}
+		global_data->lvs_syncd.vrrp = vrrp_name_lookup(vrrp_data, global_data->lvs_syncd.vrrp_name);
 
 		if (!global_data->lvs_syncd.vrrp) {
 			log_message(LOG_INFO, "Unable to find vrrp instance %s for lvs_syncd - clearing lvs_syncd config", global_data->lvs_syncd.vrrp_name);
@@ -2461,20 +2990,7 @@ vrrp_ipvs_needed(void)
 static vrrp_t *
 vrrp_exist(vrrp_t * old_vrrp)
 {
-	element e;
-	list l = vrrp_data->vrrp;
-	vrrp_t *vrrp;
-
-	if (LIST_ISEMPTY(l))
-		return NULL;
-
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		vrrp = ELEMENT_DATA(e);
-		if (!strcmp(vrrp->iname, old_vrrp->iname))
-			return vrrp;
-	}
-
-	return NULL;
+	return vrrp_name_lookup(vrrp_data, old_vrrp->iname);
 }
 
 /* Clear VIP|EVIP not present into the new data */
@@ -35,43 +35,162 @@
 #include "old_socket.h"
 #endif
 
+/* Length of a gratuitous ARP frame */
+#define GARP_FRAME_LEN		(ETHER_HDR_LEN + sizeof(arphdr_t))
+
+/* A prebuilt frame waiting to be sent */
+typedef struct _garp_gna_tx {
+	int			fd;
+	ip_address_t		*ipaddress;
+} garp_gna_tx_t;
+
 /* static vars */
-static char *garp_buffer;
 static int garp_fd;
+static garp_gna_tx_t garp_gna_tx[GARP_GNA_TX_BATCH];
+static int garp_gna_tx_count;
 
-/* Send the gratuitous ARP message */
-static int send_arp(ip_address_t *ipaddress)
+/* Is the prebuilt frame of an address still the one for its interface ? */
+bool
+garp_gna_frame_valid(ip_address_t *ipaddress)
 {
-	struct sockaddr_ll sll;
-	int len;
+	return ipaddress->garp_gna_frame &&
+	       ipaddress->garp_gna_ifindex == IF_INDEX(ipaddress->ifp) &&
+	       !memcmp(ipaddress->garp_gna_frame + ETH_ALEN, IF_HWADDR(ipaddress->ifp), ETH_ALEN);
+}
 
-	/* Build the dst device */
-	memset(&sll, 0, sizeof(sll));
-	sll.sll_family = AF_PACKET;
-	memcpy(sll.sll_addr, IF_HWADDR(ipaddress->ifp), ETH_ALEN);
-	sll.sll_halen = ETHERNET_HW_LEN;
-	sll.sll_ifindex = IF_INDEX(ipaddress->ifp);
+/* Queue a prebuilt frame, for a single sendmmsg() with the others */
+void
+garp_gna_queue(int fd, ip_address_t *ipaddress)
+{
+	if (garp_gna_tx_count == GARP_GNA_TX_BATCH)
+		garp_gna_send_queued();
 
-	if (__test_bit(LOG_DETAIL_BIT, &debug))
-		log_message(LOG_INFO, "Sending gratuitous ARP on %s for %s",
-			    IF_NAME(ipaddress->ifp), inet_ntop2(ipaddress->u.sin.sin_addr.s_addr));
+	garp_gna_tx[garp_gna_tx_count].fd = fd;
+	garp_gna_tx[garp_gna_tx_count++].ipaddress = ipaddress;
+}
 
-	/* Send packet */
-	len = sendto(garp_fd, garp_buffer, sizeof(arphdr_t) + ETHER_HDR_LEN
-		     , 0, (struct sockaddr *)&sll, sizeof(sll));
-	if (len < 0)
+static void
+garp_gna_send_err(ip_address_t *ipaddress)
+{
+	char addr_str[INET6_ADDRSTRLEN];
+
+	if (IP_IS6(ipaddress)) {
+		inet_ntop(AF_INET6, &ipaddress->u.sin6_addr, addr_str, sizeof(addr_str));
+		log_message(LOG_INFO, "VRRP: Error sending ndisc unsolicited neighbour advert on %s for %s",
+			    IF_NAME(ipaddress->ifp), addr_str);
+	} else
 		log_message(LOG_INFO, "Error sending gratuitous ARP on %s for %s",
 			    IF_NAME(ipaddress->ifp), inet_ntop2(ipaddress->u.sin.sin_addr.s_addr));
-	return len;
 }
 
-/* Build a gratuitous ARP message over a specific interface */
-int send_gratuitous_arp_immediate(interface_t *ifp, ip_address_t *ipaddress)
+/* Send the queued frames, a sendmmsg() for each run of frames on the same socket */
+void
+garp_gna_send_queued(void)
 {
-	struct ether_header *eth = (struct ether_header *) garp_buffer;
-	arphdr_t *arph		 = (arphdr_t *) (garp_buffer + ETHER_HDR_LEN);
-	char *hwaddr		 = (char *) IF_HWADDR(ipaddress->ifp);
-	int len;
+#ifdef _HAVE_SENDMMSG_
+	struct mmsghdr msgs[GARP_GNA_TX_BATCH];
+#else
+	struct msghdr msgs[GARP_GNA_TX_BATCH];
+#endif
+	struct msghdr *msg;
+	struct iovec iovs[GARP_GNA_TX_BATCH];
+	struct sockaddr_ll slls[GARP_GNA_TX_BATCH];
+	garp_gna_tx_t *tx = garp_gna_tx;
+	ip_address_t *ipaddress;
+	int i, n, sent, ret;
+
+	for (i = 0; i < garp_gna_tx_count; i++) {
+		ipaddress = tx[i].ipaddress;
+
+		/* Build the dst device */
+		memset(&slls[i], 0, sizeof(slls[i]));
+		slls[i].sll_family = AF_PACKET;
+		memcpy(slls[i].sll_addr, IF_HWADDR(ipaddress->ifp), ETH_ALEN);
+		slls[i].sll_halen = ETHERNET_HW_LEN;
+		slls[i].sll_ifindex = IF_INDEX(ipaddress->ifp);
+
+		iovs[i].iov_base = ipaddress->garp_gna_frame;
+		iovs[i].iov_len = ipaddress->garp_gna_frame_len;
+
+		memset(&msgs[i], 0, sizeof(msgs[i]));
+#ifdef _HAVE_SENDMMSG_
+		msg = &msgs[i].msg_hdr;
+#else
+		msg = &msgs[i];
+#endif
+		msg->msg_name = &slls[i];
+		msg->msg_namelen = sizeof(slls[i]);
+		msg->msg_iov = &iovs[i];
+		msg->msg_iovlen = 1;
+	}
+
+	for (i = 0; i < garp_gna_tx_count; i += n) {
+		for (n = 1; i + n < garp_gna_tx_count && tx[i + n].fd == tx[i].fd; n++)
+			;
+
+		/* Sending stops at the first failed frame, report it and go on */
+		for (sent = 0; sent < n; sent += ret) {
+#ifdef _HAVE_SENDMMSG_
+			ret = sendmmsg(tx[i].fd, &msgs[i + sent], n - sent, 0);
+#else
+			ret = (sendmsg(tx[i].fd, &msgs[i + sent], 0) < 0) ? -1 : 1;
+#endif
+			if (ret <= 0) {
+				garp_gna_send_err(tx[i + sent].ipaddress);
+				ret = 1;
+			}
+		}
+	}
+
+	garp_gna_tx_count = 0;
+}
+
+/* (Re)schedule the delayed ARP/NA thread, if it is due before */
+static void
+garp_gna_schedule(timeval_t next_time)
+{
+	if (garp_thread && timer_cmp(next_time, garp_next_time) >= 0)
+		return;
+
+	if (garp_thread)
+		thread_cancel(garp_thread);
+
+	garp_next_time = next_time;
+	garp_thread = thread_add_timer(master, vrrp_arp_thread, NULL, -timer_long(timer_sub_now(garp_next_time)));
+}
+
+/* Queue an address on its interface, until the interface pacing lets it go */
+void
+garp_gna_delay(list *queue, timeval_t next_time, ip_address_t *ipaddress)
+{
+	/* Already waiting for its turn */
+	if (ipaddress->garp_gna_pending)
+		return;
+
+	ipaddress->garp_gna_pending = true;
+	if (!*queue)
+		*queue = alloc_list(NULL, NULL);
+	list_add(*queue, ipaddress);
+
+	garp_gna_schedule(next_time);
+}
+
+/* Build the gratuitous ARP frame of an address, on its interface */
+void
+build_gratuitous_arp(ip_address_t *ipaddress)
+{
+	struct ether_header *eth;
+	arphdr_t *arph;
+	char *hwaddr = (char *) IF_HWADDR(ipaddress->ifp);
+
+	if (!ipaddress->garp_gna_frame)
+		ipaddress->garp_gna_frame = (unsigned char *) MALLOC(GARP_FRAME_LEN);
+	ipaddress->garp_gna_frame_len = GARP_FRAME_LEN;
+	ipaddress->garp_gna_ifindex = IF_INDEX(ipaddress->ifp);
+
+	eth = (struct ether_header *) ipaddress->garp_gna_frame;
+	arph = (arphdr_t *) (ipaddress->garp_gna_frame + ETHER_HDR_LEN);
+	memset(eth, 0, GARP_FRAME_LEN);
 
 	/* Ethernet header */
 	memset(eth->ether_dhost, 0xFF, ETH_ALEN);
@@ -88,49 +207,36 @@ int send_gratuitous_arp_immediate(interface_t *ifp, ip_address_t *ipaddress)
 	memcpy(arph->__ar_sip, &ipaddress->u.sin.sin_addr.s_addr, sizeof(struct in_addr));
 	memset(arph->__ar_tha, 0xFF, ETH_ALEN);
 	memcpy(arph->__ar_tip, &ipaddress->u.sin.sin_addr.s_addr, sizeof(struct in_addr));
-
-	/* Send the ARP message */
-	len = send_arp(ipaddress);
-
-	/* If we have to delay between sending garps, note the next time we can */
-	if (ifp->garp_delay && ifp->garp_delay->have_garp_interval)
-		ifp->garp_delay->garp_next_time = timer_add_now(ifp->garp_delay->garp_interval);
-
-	/* Cleanup room for next round */
-	memset(garp_buffer, 0, sizeof(arphdr_t) + ETHER_HDR_LEN);
-	return len;
 }
 
-static void queue_garp(vrrp_t *vrrp, interface_t *ifp, ip_address_t *ipaddress)
+/* Queue the gratuitous ARP message of an address, sent with the next batch */
+void send_gratuitous_arp_immediate(interface_t *ifp, ip_address_t *ipaddress)
 {
-	timeval_t next_time = timer_add_now(ifp->garp_delay->garp_interval);
+	/* The interface was recreated or changed its address */
+	if (!garp_gna_frame_valid(ipaddress))
+		build_gratuitous_arp(ipaddress);
 
-	vrrp->garp_pending = true;
-	ipaddress->garp_gna_pending = true;
-
-	/* Do we need to reschedule the garp thread? */
-	if (!garp_thread || timer_cmp(next_time, garp_next_time) < 0) {
-		if (garp_thread)
-			thread_cancel(garp_thread);
+	if (__test_bit(LOG_DETAIL_BIT, &debug))
+		log_message(LOG_INFO, "Sending gratuitous ARP on %s for %s",
+			    IF_NAME(ipaddress->ifp), inet_ntop2(ipaddress->u.sin.sin_addr.s_addr));
 
-		garp_next_time = next_time;
+	garp_gna_queue(garp_fd, ipaddress);
 
-		garp_thread = thread_add_timer(master, vrrp_arp_thread, NULL, -timer_long(timer_sub_now(garp_next_time)));
-	}
+	/* If we have to delay between sending garps, note the next time we can */
+	if (ifp->garp_delay && ifp->garp_delay->have_garp_interval)
+		ifp->garp_delay->garp_next_time = timer_add_now(ifp->garp_delay->garp_interval);
 }
 
 void send_gratuitous_arp(vrrp_t *vrrp, ip_address_t *ipaddress)
 {
 	interface_t *ifp = IF_BASE_IFP(ipaddress->ifp);
 
-	set_time_now();
-
 	/* Do we need to delay sending the garp? */
 	if (ifp->garp_delay &&
 	    ifp->garp_delay->have_garp_interval &&
 	    ifp->garp_delay->garp_next_time.tv_sec) {
 		if (timer_cmp(time_now, ifp->garp_delay->garp_next_time) < 0) {
-			queue_garp(vrrp, ifp, ipaddress);
+			garp_gna_delay(&ifp->garp_delay->garp_queue, ifp->garp_delay->garp_next_time, ipaddress);
 			return;
 		}
 	}
@@ -143,8 +249,9 @@ void send_gratuitous_arp(vrrp_t *vrrp, ip_address_t *ipaddress)
  */
 void gratuitous_arp_init(void)
 {
-	/* Initalize shared buffer */
-	garp_buffer = (char *)MALLOC(sizeof(arphdr_t) + ETHER_HDR_LEN);
+	/* The delayed ARP/NA thread went with the previous master */
+	garp_thread = NULL;
+	garp_gna_tx_count = 0;
 
 	/* Create the socket descriptor */
 	garp_fd = socket(PF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(ETH_P_RARP));
@@ -163,6 +270,5 @@ void gratuitous_arp_init(void)
 }
 void gratuitous_arp_close(void)
 {
-	FREE(garp_buffer);
 	close(garp_fd);
 }
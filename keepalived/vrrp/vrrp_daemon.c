@@ -145,6 +145,7 @@ static void
 start_vrrp(void)
 {
 	/* Initialize sub-system */
+	netlink_scoped = !!__test_bit(SCOPED_NETLINK_BIT, &debug);
 	init_interface_queue();
 	kernel_netlink_init();
 	gratuitous_arp_init();
@@ -172,6 +173,8 @@ start_vrrp(void)
 	if (global_data->vrrp_no_swap)
 		set_process_dont_swap(4096);	/* guess a stack size to reserve */
 
+	thread_set_pool_max(master, global_data->thread_pool_max);
+
 #ifdef _WITH_SNMP_
 	if (!reload && (global_data->enable_snmp_keepalived || global_data->enable_snmp_rfcv2 || global_data->enable_snmp_rfcv3)) {
 		vrrp_snmp_agent_init(global_data->snmp_socket);
@@ -362,6 +365,9 @@ reload_vrrp_thread(thread_t * thread)
 			       true, false);
 #endif
 
+	/* The deletes queued by clear_diff_*() refer to the old data */
+	netlink_cmd_complete();
+
 	/* free backup data */
 	free_vrrp_data(old_vrrp_data);
 	free_old_interface_queue();
@@ -160,15 +160,26 @@ static void
 free_sock(void *sock_data)
 {
 	sock_t *sock = sock_data;
+	unsigned i;
 
 	/* First of all cancel pending thread */
 	thread_cancel(sock->thread);
 
+	/* The instances outlive the pool on reload, and drop their queued adverts */
+	for (i = 0; i < sock->sands_count; i++) {
+		sock->sands[i]->sock = NULL;
+		sock->sands[i]->send_queued = false;
+	}
+
 	/* Close related socket */
 	if (sock->fd_in > 0)
 		close(sock->fd_in);
 	if (sock->fd_out > 0)
 		close(sock->fd_out);
+	FREE_PTR(sock->sands);
+#ifdef _HAVE_SENDMMSG_
+	FREE_PTR(sock->tx);
+#endif
 	FREE(sock_data);
 }
 
@@ -206,6 +217,7 @@ free_vrrp(void *data)
 
 	FREE(vrrp->iname);
 	FREE_PTR(vrrp->send_buffer);
+	free_vrrp_vip_set(vrrp);
 	FREE_PTR(vrrp->script_backup);
 	FREE_PTR(vrrp->script_master);
 	FREE_PTR(vrrp->script_fault);
@@ -354,6 +366,7 @@ alloc_vrrp_sync_group(char *gname)
 	new->global_tracking = 0;
 
 	list_add(vrrp_data->vrrp_sync_group, new);
+	alloc_vgroup_name_bucket(new);
 }
 
 vrrp_stats *
@@ -368,6 +381,7 @@ alloc_vrrp_stats(void)
 	new->packet_len_err = 0;
 	new->advert_rcvd = 0;
 	new->advert_sent = 0;
+	new->advert_send_err = 0;
 	new->advert_interval_err = 0;
 	new->auth_failure = 0;
 	new->ip_ttl_err = 0;
@@ -416,6 +430,7 @@ alloc_vrrp(char *iname)
 	new->strict_mode = -1;
 
 	list_add(vrrp_data->vrrp, new);
+	alloc_vrrp_name_bucket(new);
 }
 
 void
@@ -537,7 +552,7 @@ alloc_vrrp_script(char *sname)
 void
 alloc_vrrp_buffer(size_t len)
 {
-	vrrp_buffer = (char *) MALLOC(len);
+	vrrp_buffer = (char *) MALLOC(len * VRRP_RX_BATCH);
 	vrrp_buffer_len = (vrrp_buffer) ? len : 0;
 }
 
@@ -557,7 +572,8 @@ alloc_vrrp_data(void)
 	new = (vrrp_data_t *) MALLOC(sizeof(vrrp_data_t));
 	new->vrrp = alloc_list(free_vrrp, dump_vrrp);
 	new->vrrp_index = alloc_mlist(NULL, NULL, 255+1);
-	new->vrrp_index_fd = alloc_mlist(NULL, NULL, 1024+1);
+	new->vrrp_name_index = alloc_mlist(NULL, NULL, VRRP_NAME_INDEX_SIZE);
+	new->vrrp_sgroup_name_index = alloc_mlist(NULL, NULL, VRRP_NAME_INDEX_SIZE);
 	new->vrrp_sync_group = alloc_list(free_vgroup, dump_vgroup);
 	new->vrrp_script = alloc_list(free_vscript, dump_vscript);
 	new->vrrp_socket_pool = alloc_list(free_sock, dump_sock);
@@ -572,7 +588,8 @@ free_vrrp_data(vrrp_data_t * data)
 	free_list(&data->static_routes);
 	free_list(&data->static_rules);
 	free_mlist(data->vrrp_index, 255+1);
-	free_mlist(data->vrrp_index_fd, 1024+1);
+	free_mlist(data->vrrp_name_index, VRRP_NAME_INDEX_SIZE);
+	free_mlist(data->vrrp_sgroup_name_index, VRRP_NAME_INDEX_SIZE);
 	free_list(&data->vrrp);
 	free_list(&data->vrrp_sync_group);
 	free_list(&data->vrrp_script);
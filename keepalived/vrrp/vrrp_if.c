@@ -60,6 +60,11 @@ typedef uint8_t u8;
 
 /* Local vars */
 static list if_queue;
+static list if_index_hash;	/* if_queue hashed by ifindex */
+static list if_name_hash;	/* and by name */
+#ifdef _HAVE_VRRP_VMAC_
+static list if_vmac_queue;	/* VMAC interfaces of if_queue */
+#endif
 static struct ifreq ifr;
 
 static list old_if_queue;
@@ -69,6 +74,39 @@ static list old_garp_delay;
 list garp_delay;
 
 /* Helper functions */
+static inline unsigned
+if_index_hashkey(unsigned int ifindex)
+{
+	return ifindex & (IF_HASH_SIZE - 1);
+}
+
+static unsigned
+if_name_hashkey(const char *ifname)
+{
+	unsigned hash = 0;
+
+	while (*ifname)
+		hash = hash * 31 + (unsigned char) *ifname++;
+
+	return hash & (IF_HASH_SIZE - 1);
+}
+
+/* Index an interface of if_queue, by its current ifindex and name */
+void
+if_hash_add(interface_t *ifp)
+{
+	list_add(&if_index_hash[if_index_hashkey(ifp->ifindex)], ifp);
+	list_add(&if_name_hash[if_name_hashkey(ifp->ifname)], ifp);
+}
+
+/* Drop the index entries, before the ifindex or name change */
+void
+if_hash_del(interface_t *ifp)
+{
+	list_del(&if_index_hash[if_index_hashkey(ifp->ifindex)], ifp);
+	list_del(&if_name_hash[if_name_hashkey(ifp->ifname)], ifp);
+}
+
 /* Return interface from interface index */
 interface_t *
 if_get_by_ifindex(const int ifindex)
@@ -76,10 +114,10 @@ if_get_by_ifindex(const int ifindex)
 	interface_t *ifp;
 	element e;
 
-	if (LIST_ISEMPTY(if_queue))
+	if (!if_index_hash)
 		return NULL;
 
-	for (e = LIST_HEAD(if_queue); e; ELEMENT_NEXT(e)) {
+	for (e = LIST_HEAD(&if_index_hash[if_index_hashkey(ifindex)]); e; ELEMENT_NEXT(e)) {
 		ifp = ELEMENT_DATA(e);
 		if (ifp->ifindex == ifindex)
 			return ifp;
@@ -111,16 +149,17 @@ base_if_get_by_ifp(interface_t *ifp)
 #endif
 }
 
+/* Return interface from interface name, among the ones already known */
 interface_t *
-if_get_by_ifname(const char *ifname)
+if_find_by_ifname(const char *ifname)
 {
 	interface_t *ifp;
 	element e;
 
-	if (LIST_ISEMPTY(if_queue))
+	if (!if_name_hash)
 		return NULL;
 
-	for (e = LIST_HEAD(if_queue); e; ELEMENT_NEXT(e)) {
+	for (e = LIST_HEAD(&if_name_hash[if_name_hashkey(ifname)]); e; ELEMENT_NEXT(e)) {
 		ifp = ELEMENT_DATA(e);
 		if (!strcmp(ifp->ifname, ifname))
 			return ifp;
@@ -128,6 +167,23 @@ if_get_by_ifname(const char *ifname)
 	return NULL;
 }
 
+/*
+ * Return interface from interface name. When tracking is scoped,
+ * interfaces are fetched from the kernel as they get named.
+ */
+interface_t *
+if_get_by_ifname(const char *ifname)
+{
+	interface_t *ifp;
+
+	ifp = if_find_by_ifname(ifname);
+	if (ifp || !netlink_scoped || !if_queue)
+		return ifp;
+
+	netlink_interface_lookup(ifname);
+	return if_find_by_ifname(ifname);
+}
+
 /* Return the interface list itself */
 list
 get_if_list(void)
@@ -135,6 +191,17 @@ get_if_list(void)
 	return if_queue;
 }
 
+static void
+free_if_hash(void)
+{
+	free_mlist(if_index_hash, IF_HASH_SIZE);
+	free_mlist(if_name_hash, IF_HASH_SIZE);
+	if_index_hash = if_name_hash = NULL;
+#ifdef _HAVE_VRRP_VMAC_
+	free_list(&if_vmac_queue);
+#endif
+}
+
 void
 reset_interface_queue(void)
 {
@@ -143,9 +210,26 @@ reset_interface_queue(void)
 
 	if_queue = NULL;
 	garp_delay = NULL;
+	free_if_hash();
 }
 
 #ifdef _HAVE_VRRP_VMAC_
+/* Mark an interface as a VMAC interface on top of base_ifindex */
+void
+if_set_vmac(interface_t *ifp, unsigned int base_ifindex)
+{
+	element e;
+
+	ifp->base_ifindex = base_ifindex;
+	ifp->vmac = true;
+
+	for (e = LIST_HEAD(if_vmac_queue); e; ELEMENT_NEXT(e)) {
+		if (ELEMENT_DATA(e) == ifp)
+			return;
+	}
+	list_add(if_vmac_queue, ifp);
+}
+
 /*
  * Reflect base interface flags on VMAC interfaces.
  * VMAC interfaces should never update it own flags, only be reflected
@@ -157,10 +241,10 @@ if_vmac_reflect_flags(const int ifindex, const unsigned long flags)
 	interface_t *ifp;
 	element e;
 
-	if (LIST_ISEMPTY(if_queue) || !ifindex)
+	if (LIST_ISEMPTY(if_vmac_queue) || !ifindex)
 		return;
 
-	for (e = LIST_HEAD(if_queue); e; ELEMENT_NEXT(e)) {
+	for (e = LIST_HEAD(if_vmac_queue); e; ELEMENT_NEXT(e)) {
 		ifp = ELEMENT_DATA(e);
 		if (ifp->vmac && ifp->base_ifindex == ifindex)
 			ifp->flags = flags;
@@ -348,11 +432,21 @@ free_if(void *data)
 }
 
 /* garp_delay facility function */
+static void
+free_garp_delay(void *data)
+{
+	garp_delay_t *delay = data;
+
+	free_list(&delay->garp_queue);
+	free_list(&delay->gna_queue);
+	FREE(delay);
+}
+
 void
 alloc_garp_delay(void)
 {
 	if (!LIST_EXISTS(garp_delay))
-		garp_delay = alloc_list(NULL, NULL);
+		garp_delay = alloc_list(free_garp_delay, NULL);
 
 	list_add(garp_delay, MALLOC(sizeof(garp_delay_t)));
 }
@@ -365,6 +459,7 @@ set_default_garp_delay(void)
 	interface_t *ifp;
 	garp_delay_t *delay;
 
+	memset(&default_delay, 0, sizeof(default_delay));
 	if (global_data->vrrp_garp_interval) {
 		default_delay.garp_interval.tv_sec = global_data->vrrp_garp_interval / 1000000;
 		default_delay.garp_interval.tv_usec = global_data->vrrp_garp_interval % 1000000;
@@ -471,12 +566,18 @@ static void
 init_if_queue(void)
 {
 	if_queue = alloc_list(free_if, dump_if);
+	if_index_hash = alloc_mlist(NULL, NULL, IF_HASH_SIZE);
+	if_name_hash = alloc_mlist(NULL, NULL, IF_HASH_SIZE);
+#ifdef _HAVE_VRRP_VMAC_
+	if_vmac_queue = alloc_list(NULL, NULL);
+#endif
 }
 
 void
 if_add_queue(interface_t * ifp)
 {
 	list_add(if_queue, ifp);
+	if_hash_add(ifp);
 }
 
 static int
@@ -545,6 +646,7 @@ if_linkbeat(const interface_t * ifp)
 void
 free_interface_queue(void)
 {
+	free_if_hash();
 	free_list(&if_queue);
 	free_list(&garp_delay);
 }
@@ -560,7 +662,8 @@ void
 init_interface_queue(void)
 {
 	init_if_queue();
-	netlink_interface_lookup();
+	if (!netlink_scoped)
+		netlink_interface_lookup(NULL);
 //	dump_list(if_queue);
 }
 
@@ -69,59 +69,155 @@ vrrp_index_lookup(const int vrid, const int fd)
 	return NULL;
 }
 
-/* FD hash table */
-void
-alloc_vrrp_fd_bucket(vrrp_t *vrrp)
+/* Name hash tables, of instances and of sync groups */
+static unsigned
+vrrp_name_hash(const char *name)
 {
-	/* We use a mod key plus 1 */
-	list_add(&vrrp_data->vrrp_index_fd[vrrp->fd_in%1024 + 1], vrrp);
+	unsigned hash = 0;
+
+	while (*name)
+		hash = hash * 31 + (unsigned char) *name++;
+
+	return hash & (VRRP_NAME_INDEX_SIZE - 1);
 }
 
 void
-remove_vrrp_fd_bucket(vrrp_t *vrrp)
+alloc_vrrp_name_bucket(vrrp_t *vrrp)
 {
-	list l = &vrrp_data->vrrp_index_fd[vrrp->fd_in%1024 + 1];
-	list_del(l, vrrp);
+	list_add(&vrrp_data->vrrp_name_index[vrrp_name_hash(vrrp->iname)], vrrp);
 }
 
-void set_vrrp_fd_bucket(int old_fd, vrrp_t *vrrp)
+vrrp_t *
+vrrp_name_lookup(vrrp_data_t *data, const char *iname)
 {
-	vrrp_t *vrrp_ptr;
+	vrrp_t *vrrp;
 	element e;
-	element next;
-	list l = &vrrp_data->vrrp_index_fd[old_fd%1024 + 1];
-
-	/* Release old stalled entries */
-	for (e = LIST_HEAD(l); e; e = next) {
-		next = e->next;
-		vrrp_ptr =  ELEMENT_DATA(e);
-		if (vrrp_ptr->fd_in == old_fd) {
-			if (e->prev)
-				e->prev->next = e->next;
-			else
-				 l->head = e->next;
-
-			if (e->next)
-				e->next->prev = e->prev;
-			else
-				l->tail = e->prev;
-			l->count--;
-			FREE(e);
-		}
+	list l = &data->vrrp_name_index[vrrp_name_hash(iname)];
+
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		vrrp = ELEMENT_DATA(e);
+		if (!strcmp(vrrp->iname, iname))
+			return vrrp;
 	}
-	if (LIST_ISEMPTY(l))
-		l->head = l->tail = NULL;
 
-	/* Hash refreshed entries */
-	l = vrrp_data->vrrp;
+	return NULL;
+}
+
+void
+alloc_vgroup_name_bucket(vrrp_sgroup_t *vgroup)
+{
+	list_add(&vrrp_data->vrrp_sgroup_name_index[vrrp_name_hash(vgroup->gname)], vgroup);
+}
+
+void
+free_vgroup_name_bucket(vrrp_sgroup_t *vgroup)
+{
+	list_del(&vrrp_data->vrrp_sgroup_name_index[vrrp_name_hash(vgroup->gname)], vgroup);
+}
+
+vrrp_sgroup_t *
+vrrp_sgroup_name_lookup(vrrp_data_t *data, const char *gname)
+{
+	vrrp_sgroup_t *vgroup;
+	element e;
+	list l = &data->vrrp_sgroup_name_index[vrrp_name_hash(gname)];
+
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		vrrp_ptr = ELEMENT_DATA(e);
-
-		if (vrrp_ptr->fd_in == old_fd) {
-			/* Update new hash */
-			vrrp_ptr->fd_in = vrrp->fd_in;
-			vrrp_ptr->fd_out = vrrp->fd_out;
-			alloc_vrrp_fd_bucket(vrrp_ptr);
-		}
+		vgroup = ELEMENT_DATA(e);
+		if (!strcmp(vgroup->gname, gname))
+			return vgroup;
+	}
+
+	return NULL;
+}
+
+/*
+ * Sands heap. Each socket of the pool keeps its instances in a binary
+ * min-heap ordered by sands, so that the dispatcher finds the next
+ * instance to time out without scanning them all.
+ */
+static inline void
+vrrp_sands_set(sock_t *sock, unsigned i, vrrp_t *vrrp)
+{
+	sock->sands[i] = vrrp;
+	vrrp->sands_index = i;
+}
+
+static void
+vrrp_sands_sift_up(sock_t *sock, unsigned i)
+{
+	vrrp_t *vrrp = sock->sands[i];
+	unsigned parent;
+
+	while (i) {
+		parent = (i - 1) / 2;
+		if (timer_cmp(sock->sands[parent]->sands, vrrp->sands) <= 0)
+			break;
+		vrrp_sands_set(sock, i, sock->sands[parent]);
+		i = parent;
+	}
+	vrrp_sands_set(sock, i, vrrp);
+}
+
+static void
+vrrp_sands_sift_down(sock_t *sock, unsigned i)
+{
+	vrrp_t *vrrp = sock->sands[i];
+	unsigned child;
+
+	while ((child = 2 * i + 1) < sock->sands_count) {
+		if (child + 1 < sock->sands_count &&
+		    timer_cmp(sock->sands[child + 1]->sands, sock->sands[child]->sands) < 0)
+			child++;
+		if (timer_cmp(vrrp->sands, sock->sands[child]->sands) <= 0)
+			break;
+		vrrp_sands_set(sock, i, sock->sands[child]);
+		i = child;
+	}
+	vrrp_sands_set(sock, i, vrrp);
+}
+
+void
+alloc_vrrp_sock_sands(sock_t *sock, vrrp_t *vrrp)
+{
+	if (sock->sands_count == sock->sands_size) {
+		sock->sands_size = sock->sands_size ? sock->sands_size * 2 : 16;
+		sock->sands = REALLOC(sock->sands, sock->sands_size * sizeof(vrrp_t *));
+	}
+
+	vrrp->sock = sock;
+	vrrp_sands_set(sock, sock->sands_count++, vrrp);
+	vrrp_sands_sift_up(sock, vrrp->sands_index);
+}
+
+/* Reorder an instance whose sands changed */
+void
+update_vrrp_sock_sands(vrrp_t *vrrp)
+{
+	sock_t *sock = vrrp->sock;
+
+	if (!sock)
+		return;
+
+	vrrp_sands_sift_up(sock, vrrp->sands_index);
+	vrrp_sands_sift_down(sock, vrrp->sands_index);
+}
+
+/* Instance with the earliest sands */
+vrrp_t *
+vrrp_sock_sands_min(sock_t *sock)
+{
+	return sock->sands_count ? sock->sands[0] : NULL;
+}
+
+/* Propagate the fds of the socket to its instances */
+void
+set_vrrp_sock_fds(sock_t *sock)
+{
+	unsigned i;
+
+	for (i = 0; i < sock->sands_count; i++) {
+		sock->sands[i]->fd_in = sock->fd_in;
+		sock->sands[i]->fd_out = sock->fd_out;
 	}
 }
@@ -54,12 +54,11 @@ ipaddresstos(char *buf, ip_address_t *ipaddress)
 	return buf;
 }
 
-/* Add/Delete IP address to a specific interface_t */
-int
-netlink_ipaddress(ip_address_t *ipaddress, int cmd)
+/* Add/Delete IP address to a specific interface_t, or queue it on a batch */
+static int
+netlink_ipaddress_cmd(ip_address_t *ipaddress, int cmd, nl_batch_t *batch)
 {
 	struct ifa_cacheinfo cinfo;
-	int status = 1;
 	struct {
 		struct nlmsghdr n;
 		struct ifaddrmsg ifa;
@@ -128,23 +127,43 @@ netlink_ipaddress(ip_address_t *ipaddress, int cmd)
 			addattr_l(&req.n, sizeof (req), IFA_LABEL,
 				  ipaddress->label, strlen(ipaddress->label) + 1);
 
-	if (netlink_talk(&nl_cmd, &req.n) < 0)
-		status = -1;
+	if (batch)
+		return netlink_batch_add(batch, &req.n, ipaddress);
+
+	return netlink_cmd_send(&req.n, cmd, NULL, NULL);
+}
+
+/* Errors are only logged, the request is sent without waiting for its ack */
+int
+netlink_ipaddress(ip_address_t *ipaddress, int cmd)
+{
+	return netlink_ipaddress_cmd(ipaddress, cmd, NULL);
+}
+
+static void
+netlink_iplist_done(void *item, int cmd, int error)
+{
+	ip_address_t *ipaddr = item;
 
-	return status;
+	ipaddr->set = !error && cmd != IPADDRESS_DEL;
 }
 
-/* Add/Delete a list of IP addresses */
+/* Add/Delete a list of IP addresses, in as few round trips as possible */
 void
 netlink_iplist(list ip_list, int cmd)
 {
 	ip_address_t *ipaddr;
+	nl_batch_t batch;
 	element e;
 
 	/* No addresses in this list */
 	if (LIST_ISEMPTY(ip_list))
 		return;
 
+	/* ->set only changes with the acks, collect those of earlier requests */
+	netlink_cmd_complete();
+	netlink_batch_init(&batch, cmd, netlink_iplist_done);
+
 	/*
 	 * If "--dont-release-vrrp" is set then try to release addresses
 	 * that may be there, even if we didn't set them.
@@ -154,12 +173,12 @@ netlink_iplist(list ip_list, int cmd)
 		if ((cmd == IPADDRESS_ADD && !ipaddr->set) ||
 		    (cmd == IPADDRESS_DEL &&
 		     (ipaddr->set || __test_bit(DONT_RELEASE_VRRP_BIT, &debug)))) {
-			if (netlink_ipaddress(ipaddr, cmd) > 0)
-				ipaddr->set = !(cmd == IPADDRESS_DEL);
-			else
+			if (netlink_ipaddress_cmd(ipaddr, cmd, &batch) <= 0)
 				ipaddr->set = 0;
 		}
 	}
+
+	netlink_batch_flush(&batch);
 }
 
 #ifndef _HAVE_LIBIPTC_
@@ -308,6 +327,7 @@ free_ipaddress(void *if_data)
 	ip_address_t *ipaddr = if_data;
 
 	FREE_PTR(ipaddr->label);
+	FREE_PTR(ipaddr->garp_gna_frame);
 	FREE(ipaddr);
 }
 
@@ -276,11 +276,10 @@ add_nexthops(ip_route_t *route, struct nlmsghdr *nlh, struct rtmsg *rtm)
 		addattr_l(nlh, sizeof(buf), RTA_MULTIPATH, RTA_DATA(rta), RTA_PAYLOAD(rta));
 }
 
-/* Add/Delete IP route to/from a specific interface */
+/* Add/Delete IP route to/from a specific interface, or queue it on a batch */
 static int
-netlink_route(ip_route_t *iproute, int cmd)
+netlink_route(ip_route_t *iproute, int cmd, nl_batch_t *batch)
 {
-	int status = 1;
 	struct {
 		struct nlmsghdr n;
 		struct rtmsg r;
@@ -480,39 +479,53 @@ netlink_route(ip_route_t *iproute, int cmd)
 		log_message(LOG_INFO, "%.*\n", MAX_LOG_MSG, lbuf+j);
 #endif
 
-	/* This returns ESRCH if the address of via address doesn't exist */
+	/* The ack is ESRCH if the address of via address doesn't exist */
 	/* ENETDOWN if dev p33p1.40 for example is down */
-	if (netlink_talk(&nl_cmd, &req.n) < 0) {
+	if (batch)
+		return netlink_batch_add(batch, &req.n, iproute);
+
+	return netlink_cmd_send(&req.n, cmd, NULL, NULL);
+}
+
+static void
+netlink_rtlist_done(void *item, int cmd, int error)
+{
+	ip_route_t *iproute = item;
+
 #ifdef _HAVE_RTA_EXPIRES_
-		/* If an expiry was set on the route, it may have disappeared already */
-		if (cmd != IPADDRESS_DEL || !(iproute->mask & IPROUTE_BIT_EXPIRES))
+	/* If an expiry was set on the route, it may have disappeared already */
+	if (error && cmd == IPROUTE_DEL && (iproute->mask & IPROUTE_BIT_EXPIRES))
+		error = 0;
 #endif
-			status = -1;
-	}
 
-	return status;
+	iproute->set = !error && cmd == IPROUTE_ADD;
 }
 
-/* Add/Delete a list of IP routes */
+/* Add/Delete a list of IP routes, in as few round trips as possible */
 void
 netlink_rtlist(list rt_list, int cmd)
 {
 	ip_route_t *iproute;
+	nl_batch_t batch;
 	element e;
 
 	/* No routes to add */
 	if (LIST_ISEMPTY(rt_list))
 		return;
 
+	/* ->set only changes with the acks, collect those of earlier requests */
+	netlink_cmd_complete();
+	netlink_batch_init(&batch, cmd, netlink_rtlist_done);
+
 	for (e = LIST_HEAD(rt_list); e; ELEMENT_NEXT(e)) {
 		iproute = ELEMENT_DATA(e);
 		if ((cmd == IPROUTE_DEL) == iproute->set) {
-			if (netlink_route(iproute, cmd) > 0)
-				iproute->set = (cmd == IPROUTE_ADD);
-			else
+			if (netlink_route(iproute, cmd, &batch) <= 0)
 				iproute->set = false;
 		}
 	}
+
+	netlink_batch_flush(&batch);
 }
 
 /* Route dump/allocation */
@@ -1702,13 +1715,13 @@ clear_diff_routes(list l, list n)
 			if (!route_exist(n, iproute)) {
 				log_message(LOG_INFO, "ip route %s/%d ... , no longer exist"
 						    , ipaddresstos(NULL, iproute->dst), iproute->dst->ifa.ifa_prefixlen);
-				netlink_route(iproute, IPROUTE_DEL);
+				netlink_route(iproute, IPROUTE_DEL, NULL);
 			}
 			else {
 				/* There are too many route options to compare to see if the
 				 * routes are the same or not, so just replace the existing route
 				 * with the new one. */
-				netlink_route(iproute, IPROUTE_REPLACE);
+				netlink_route(iproute, IPROUTE_REPLACE, NULL);
 			}
 		}
 	}
@@ -97,11 +97,10 @@ rule_is_equal(const ip_rule_t *x, const ip_rule_t *y)
 	return true;
 }
 
-/* Add/Delete IP rule to/from a specific IP/network */
+/* Add/Delete IP rule to/from a specific IP/network, or queue it on a batch */
 static int
-netlink_rule(ip_rule_t *iprule, int cmd)
+netlink_rule(ip_rule_t *iprule, int cmd, nl_batch_t *batch)
 {
-	int status = 1;
 	struct {
 		struct nlmsghdr n;
 		struct fib_rule_hdr frh;
@@ -198,22 +197,36 @@ netlink_rule(ip_rule_t *iprule, int cmd)
 
 	req.frh.action = iprule->action;
 
-	if (netlink_talk(&nl_cmd, &req.n) < 0)
-		status = -1;
+	if (batch)
+		return netlink_batch_add(batch, &req.n, iprule);
 
-	return status;
+	return netlink_cmd_send(&req.n, cmd, NULL, NULL);
 }
 
+static void
+netlink_rulelist_done(void *item, int cmd, int error)
+{
+	ip_rule_t *iprule = item;
+
+	iprule->set = !error && cmd == IPRULE_ADD;
+}
+
+/* Add/Delete a list of IP rules, in as few round trips as possible */
 void
 netlink_rulelist(list rule_list, int cmd, bool force)
 {
 	ip_rule_t *iprule;
+	nl_batch_t batch;
 	element e;
 
 	/* No rules to add */
 	if (LIST_ISEMPTY(rule_list))
 		return;
 
+	/* ->set only changes with the acks, collect those of earlier requests */
+	netlink_cmd_complete();
+	netlink_batch_init(&batch, cmd, netlink_rulelist_done);
+
 	/* If force is set, we try to remove all the rules, but the
 	 * rule might not exist. That's not an error, so indicate not
 	 * to report such a situation */
@@ -225,13 +238,13 @@ netlink_rulelist(list rule_list, int cmd, bool force)
 		if (force ||
 		    (cmd == IPRULE_ADD && !iprule->set) ||
 		    (cmd == IPRULE_DEL && iprule->set)) {
-			if (netlink_rule(iprule, cmd) > 0)
-				iprule->set = (cmd == IPRULE_ADD);
-			else
+			if (netlink_rule(iprule, cmd, &batch) <= 0)
 				iprule->set = false;
 		}
 	}
 
+	netlink_batch_flush(&batch);
+
 	netlink_error_ignore = 0;
 }
 
@@ -649,7 +662,7 @@ clear_diff_rules(list l, list n)
 		if (!rule_exist(n, iprule) && iprule->set) {
 			log_message(LOG_INFO, "ip rule %s/%d ... , no longer exist"
 					    , ipaddresstos(NULL, iprule->from_addr), iprule->from_addr->ifa.ifa_prefixlen);
-			netlink_rule(iprule, IPRULE_DEL);
+			netlink_rule(iprule, IPRULE_DEL, NULL);
 		}
 	}
 }
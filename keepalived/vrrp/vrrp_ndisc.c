@@ -33,63 +33,26 @@
 #include "vrrp_if_config.h"
 #include "vrrp_scheduler.h"
 #include "vrrp_ndisc.h"
+#include "vrrp_arp.h"
 #ifndef _HAVE_SOCK_CLOEXEC_
 #include "old_socket.h"
 #endif
 #include "bitops.h"
 
+/* Length of an unsolicited Neighbour Advertisement frame */
+#define NDISC_NA_FRAME_LEN	(ETHER_HDR_LEN + sizeof(struct ip6hdr) + sizeof(struct ndhdr) + \
+				 sizeof(struct nd_opt_hdr) + ETH_ALEN)
+
 /* static vars */
-static char *ndisc_buffer;
 static int ndisc_fd;
 
-/*
- *	Neighbour Advertisement sending routine.
- */
-static int
-ndisc_send_na(ip_address_t *ipaddress)
-{
-	struct sockaddr_ll sll;
-	int len;
-	char addr_str[INET6_ADDRSTRLEN] = "";
-
-	/* Build the dst device */
-	memset(&sll, 0, sizeof (sll));
-	sll.sll_family = AF_PACKET;
-	memcpy(sll.sll_addr, IF_HWADDR(ipaddress->ifp), ETH_ALEN);
-	sll.sll_halen = ETHERNET_HW_LEN;
-	sll.sll_ifindex = IF_INDEX(ipaddress->ifp);
-
-	if (__test_bit(LOG_DETAIL_BIT, &debug)) {
-		inet_ntop(AF_INET6, &ipaddress->u.sin6_addr, addr_str, sizeof(addr_str));
-		log_message(LOG_INFO, "Sending unsolicited Neighbour Advert on %s for %s",
-			    IF_NAME(ipaddress->ifp), addr_str);
-	
-	}
-
-	/* Send packet */
-	len = sendto(ndisc_fd, ndisc_buffer,
-		     ETHER_HDR_LEN + sizeof(struct ip6hdr) + sizeof(struct ndhdr) +
-		     sizeof(struct nd_opt_hdr) + ETH_ALEN, 0,
-		     (struct sockaddr *) &sll, sizeof (sll));
-	if (len < 0) {
-		if (!addr_str[0])
-			inet_ntop(AF_INET6, &ipaddress->u.sin6_addr, addr_str, sizeof(addr_str));
-		log_message(LOG_INFO, "VRRP: Error sending ndisc unsolicited neighbour advert on %s for %s",
-			    IF_NAME(ipaddress->ifp), addr_str);
-	}
-
-	return len;
-}
-
 /*
  *	ICMPv6 Checksuming.
  */
 static uint32_t
 ndisc_icmp6_cksum(const struct ip6hdr *ip6, const struct icmp6hdr *icp, uint32_t len)
 {
-	size_t i;
-	register const uint16_t *sp;
-	uint32_t sum;
+	int sum = 0;
 	union {
 		struct {
 			struct in6_addr ph_src;
@@ -108,23 +71,8 @@ ndisc_icmp6_cksum(const struct ip6hdr *ip6, const struct icmp6hdr *icp, uint32_t
 	phu.ph.ph_len = htonl(len);
 	phu.ph.ph_nxt = IPPROTO_ICMPV6;
 
-	sum = 0;
-	for (i = 0; i < sizeof(phu.pa) / sizeof(phu.pa[0]); i++)
-		sum += phu.pa[i];
-
-	sp = (const uint16_t *)icp;
-
-	for (i = 0; i < (len & ~1); i += 2)
-		sum += *sp++;
-
-	if (len & 1)
-		sum += htons((*(const uint8_t *)sp) << 8);
-
-	while (sum > 0xffff)
-		sum = (sum & 0xffff) + (sum >> 16);
-	sum = ~sum & 0xffff;
-
-	return (sum);
+	in_csum(phu.pa, sizeof(phu.pa), 0, &sum);
+	return in_csum((u_short *) icp, len, sum, NULL);
 }
 
 /*
@@ -133,26 +81,34 @@ ndisc_icmp6_cksum(const struct ip6hdr *ip6, const struct icmp6hdr *icp, uint32_t
  *	Neighbor Advertisements in order to (unreliably) propagate
  *	new information quickly.
  */
-int
-ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
+void
+ndisc_build_unsolicited_na(ip_address_t *ipaddress)
 {
-	struct ether_header *eth = (struct ether_header *) ndisc_buffer;
-	struct ip6hdr *ip6h = (struct ip6hdr *) ((char *)eth + ETHER_HDR_LEN);
-	struct ndhdr *ndh = (struct ndhdr*) ((char *)ip6h + sizeof(struct ip6hdr));
-	struct icmp6hdr *icmp6h = &ndh->icmph;
-	struct nd_opt_hdr *nd_opt_h = (struct nd_opt_hdr *) ((char *)ndh + sizeof(struct ndhdr));
-	char *nd_opt_lladdr = (char *) ((char *)nd_opt_h + sizeof(struct nd_opt_hdr));
+	struct ether_header *eth;
+	struct ip6hdr *ip6h;
+	struct ndhdr *ndh;
+	struct icmp6hdr *icmp6h;
+	struct nd_opt_hdr *nd_opt_h;
+	char *nd_opt_lladdr;
 	char *lladdr = (char *) IF_HWADDR(ipaddress->ifp);
-	int len;
-	bool router;
 
-	router = get_ipv6_forwarding(ifp);
+	if (!ipaddress->garp_gna_frame)
+		ipaddress->garp_gna_frame = (unsigned char *) MALLOC(NDISC_NA_FRAME_LEN);
+	ipaddress->garp_gna_frame_len = NDISC_NA_FRAME_LEN;
+	ipaddress->garp_gna_ifindex = IF_INDEX(ipaddress->ifp);
+
+	eth = (struct ether_header *) ipaddress->garp_gna_frame;
+	ip6h = (struct ip6hdr *) ((char *)eth + ETHER_HDR_LEN);
+	ndh = (struct ndhdr*) ((char *)ip6h + sizeof(struct ip6hdr));
+	icmp6h = &ndh->icmph;
+	nd_opt_h = (struct nd_opt_hdr *) ((char *)ndh + sizeof(struct ndhdr));
+	nd_opt_lladdr = (char *) ((char *)nd_opt_h + sizeof(struct nd_opt_hdr));
+	memset(eth, 0, NDISC_NA_FRAME_LEN);
 
 	/* Ethernet header:
 	 * Destination ethernet address MUST use specific address Mapping
 	 * as specified in rfc2464.7 Address Mapping for
 	 */
-	memset(eth->ether_dhost, 0, ETH_ALEN);
 	eth->ether_dhost[0] = eth->ether_dhost[1] = 0x33;
 	eth->ether_dhost[5] = 1;
 	memcpy(eth->ether_shost, lladdr, ETH_ALEN);
@@ -169,7 +125,7 @@ ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
 
 	/* ICMPv6 Header */
 	icmp6h->icmp6_type = NDISC_NEIGHBOUR_ADVERTISEMENT;
-	icmp6h->icmp6_router = router;
+	icmp6h->icmp6_router = get_ipv6_forwarding(IF_BASE_IFP(ipaddress->ifp));
 
 	/* Override flag is set to indicate that the advertisement
 	 * should override an existing cache entry and update the
@@ -186,38 +142,29 @@ ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
 	/* Compute checksum */
 	icmp6h->icmp6_cksum = ndisc_icmp6_cksum(ip6h, icmp6h,
 						sizeof(struct ndhdr) + sizeof(struct nd_opt_hdr) + ETH_ALEN);
-
-	/* Send the neighbor advertisement message */
-	len = ndisc_send_na(ipaddress);
-
-	/* Cleanup room for next round */
-	memset(ndisc_buffer, 0, ETHER_HDR_LEN + sizeof(struct ip6hdr) +
-	       sizeof(struct ndhdr) + sizeof(struct nd_opt_hdr) + ETH_ALEN);
-
-	/* If we have to delay between sending NAs, note the next time we can */
-	if (ifp->garp_delay && ifp->garp_delay->have_gna_interval)
-		ifp->garp_delay->gna_next_time = timer_add_now(ifp->garp_delay->gna_interval);
-
-	return len;
 }
 
-static void
-queue_ndisc(vrrp_t *vrrp, interface_t *ifp, ip_address_t *ipaddress)
+/* Queue the unsolicited Neighbour Advertisement of an address, sent with the next batch */
+void
+ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
 {
-        timeval_t next_time = timer_add_now(ifp->garp_delay->gna_interval);
+	char addr_str[INET6_ADDRSTRLEN];
 
-	vrrp->gna_pending = true;
-	ipaddress->garp_gna_pending = true;
+	/* The interface was recreated or changed its address */
+	if (!garp_gna_frame_valid(ipaddress))
+		ndisc_build_unsolicited_na(ipaddress);
 
-	/* Do we need to schedule/reschedule the garp thread? */
-	if (!garp_thread || timer_cmp(next_time, garp_next_time) < 0) {
-		if (garp_thread)
-			thread_cancel(garp_thread);
+	if (__test_bit(LOG_DETAIL_BIT, &debug)) {
+		inet_ntop(AF_INET6, &ipaddress->u.sin6_addr, addr_str, sizeof(addr_str));
+		log_message(LOG_INFO, "Sending unsolicited Neighbour Advert on %s for %s",
+			    IF_NAME(ipaddress->ifp), addr_str);
+	}
 
-		garp_next_time = next_time;
+	garp_gna_queue(ndisc_fd, ipaddress);
 
-		garp_thread = thread_add_timer(master, vrrp_arp_thread, NULL, -timer_long(timer_sub_now(garp_next_time)));
-	}
+	/* If we have to delay between sending NAs, note the next time we can */
+	if (ifp->garp_delay && ifp->garp_delay->have_gna_interval)
+		ifp->garp_delay->gna_next_time = timer_add_now(ifp->garp_delay->gna_interval);
 }
 
 void
@@ -225,12 +172,10 @@ ndisc_send_unsolicited_na(vrrp_t *vrrp, ip_address_t *ipaddress)
 {
 	interface_t *ifp = IF_BASE_IFP(ipaddress->ifp);
 
-	set_time_now();
-
 	/* Do we need to delay sending the ndisc? */
 	if (ifp->garp_delay && ifp->garp_delay->have_gna_interval && ifp->garp_delay->gna_next_time.tv_sec) {
 		if (timer_cmp(time_now, ifp->garp_delay->gna_next_time) < 0) {
-			queue_ndisc(vrrp, ifp, ipaddress);
+			garp_gna_delay(&ifp->garp_delay->gna_queue, ifp->garp_delay->gna_next_time, ipaddress);
 			return;
 		}
 	}
@@ -244,10 +189,6 @@ ndisc_send_unsolicited_na(vrrp_t *vrrp, ip_address_t *ipaddress)
 void
 ndisc_init(void)
 {
-	/* Initalize shared buffer */
-	ndisc_buffer = (char *) MALLOC(ETHER_HDR_LEN + sizeof(struct ip6hdr) +
-				       sizeof(struct ndhdr) + sizeof(struct nd_opt_hdr) + ETH_ALEN);
-
 	/* Create the socket descriptor */
 	ndisc_fd = socket(PF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(ETH_P_IPV6));
 #ifndef _HAVE_SOCK_CLOEXEC_
@@ -258,6 +199,5 @@ ndisc_init(void)
 void
 ndisc_close(void)
 {
-	FREE(ndisc_buffer);
 	close(ndisc_fd);
 }
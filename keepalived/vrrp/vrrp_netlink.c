@@ -34,6 +34,7 @@
 #include <time.h>
 #include <sys/uio.h>
 #include <stdarg.h>
+#include <poll.h>
 
 /* local include */
 #include "check_api.h"
@@ -53,6 +54,7 @@
 /* Global vars */
 nl_handle_t nl_cmd;	/* Command channel */
 int netlink_error_ignore; /* If we get this error, ignore it */
+bool netlink_scoped;	/* Only track the configured interfaces */
 
 /* Static vars */
 static nl_handle_t nl_kernel;	/* Kernel reflection channel */
@@ -466,13 +468,13 @@ netlink_if_address_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	if (len < 0)
 		return -1;
 
-	memset(tb, 0, sizeof (tb));
-	parse_rtattr(tb, IFA_MAX, IFA_RTA(ifa), len);
-
-	/* Fetch interface_t */
+	/* Fetch interface_t, before parsing anything for untracked ones */
 	ifp = if_get_by_ifindex(ifa->ifa_index);
 	if (!ifp)
 		return 0;
+
+	memset(tb, 0, sizeof (tb));
+	parse_rtattr(tb, IFA_MAX, IFA_RTA(ifa), len);
 	if (tb[IFA_LOCAL] == NULL)
 		tb[IFA_LOCAL] = tb[IFA_ADDRESS];
 	if (tb[IFA_ADDRESS] == NULL)
@@ -535,6 +537,8 @@ netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 				continue;
 			if (errno == EWOULDBLOCK || errno == EAGAIN)
 				break;
+			if (errno == ENOBUFS)
+				nl->overrun = true;
 			log_message(LOG_INFO, "Netlink: Received message overrun (%m)");
 			continue;
 		}
@@ -600,6 +604,8 @@ netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 					       err->msg.nlmsg_type,
 					       err->msg.nlmsg_seq, err->msg.nlmsg_pid);
 
+				/* Let the caller tell which error it was */
+				errno = -err->error;
 				return -1;
 			}
 
@@ -638,6 +644,356 @@ netlink_talk_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	return 0;
 }
 
+/*
+ * Asynchronous command channel. Requests on nl_cmd ask for an ack but
+ * are sent without waiting for it: they are queued on nl_cmd_pending
+ * and a read thread on nl_cmd.fd matches the acks back to them by
+ * sequence number, calling done() with 0 or the negative errno of
+ * each request.
+ */
+static list nl_cmd_pending;
+
+static int kernel_netlink_cmd(thread_t *);
+
+static void
+free_nl_cmd_req(void *data)
+{
+	nl_cmd_req_t *req = data;
+
+	FREE_PTR(req->n);
+	FREE(data);
+}
+
+/* Queue a sent request until its ack is read */
+static void
+netlink_cmd_pending_add(struct nlmsghdr *n, int cmd, void (*done) (void *, int, int), void *item)
+{
+	nl_cmd_req_t *req;
+
+	req = (nl_cmd_req_t *) MALLOC(sizeof(nl_cmd_req_t));
+	req->seq = n->nlmsg_seq;
+	req->type = n->nlmsg_type;
+	req->cmd = cmd;
+	req->error_ignore = netlink_error_ignore;
+	req->done = done;
+	req->item = item;
+
+	/* An address delete error is handled with the request */
+	if (n->nlmsg_type == RTM_DELADDR) {
+		req->n = (struct nlmsghdr *) MALLOC(n->nlmsg_len);
+		memcpy(req->n, n, n->nlmsg_len);
+	}
+
+	list_add(nl_cmd_pending, req);
+
+	if (!nl_cmd.thread)
+		nl_cmd.thread = thread_add_read(master, kernel_netlink_cmd, &nl_cmd,
+						nl_cmd.fd, NETLINK_TIMER);
+}
+
+/* Complete the request at the head of the queue */
+static void
+netlink_cmd_done(int error)
+{
+	element e = LIST_HEAD(nl_cmd_pending);
+	nl_cmd_req_t *req = ELEMENT_DATA(e);
+
+	/* Same as netlink_parse_info(), nothing left to do */
+	if (error == -EEXIST &&
+	    (req->type == RTM_NEWROUTE || req->type == RTM_NEWADDR))
+		error = 0;
+	else if (error == -EADDRNOTAVAIL && req->type == RTM_DELADDR) {
+		netlink_if_address_filter(NULL, req->n);
+		error = 0;
+	} else if (error && req->error_ignore != -error)
+		log_message(LOG_INFO, "Netlink: error: %s, type=(%u), seq=%u",
+		       strerror(-error), req->type, req->seq);
+
+	if (req->done)
+		req->done(req->item, req->cmd, error);
+
+	free_list_element(nl_cmd_pending, e);
+}
+
+/* Acks come in the order the requests were sent */
+static void
+netlink_cmd_ack(struct nlmsghdr *h)
+{
+	struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA(h);
+	nl_cmd_req_t *req;
+	int error;
+
+	if (h->nlmsg_len < NLMSG_LENGTH(sizeof (struct nlmsgerr))) {
+		log_message(LOG_INFO, "Netlink: error: message truncated");
+		error = -EIO;
+	} else
+		error = err->error;
+
+	while (!LIST_ISEMPTY(nl_cmd_pending)) {
+		req = ELEMENT_DATA(LIST_HEAD(nl_cmd_pending));
+
+		/* Stale ack, of a request that is no longer pending */
+		if ((int32_t) (h->nlmsg_seq - req->seq) < 0)
+			return;
+
+		if (h->nlmsg_seq == req->seq) {
+			netlink_cmd_done(error);
+			return;
+		}
+
+		/* An earlier request, whose ack was lost */
+		netlink_cmd_done(-ENOBUFS);
+	}
+}
+
+/* Fail all the pending requests */
+static void
+netlink_cmd_fail(int error)
+{
+	while (!LIST_ISEMPTY(nl_cmd_pending))
+		netlink_cmd_done(error);
+}
+
+/*
+ * Read the acks of the pending requests. The kernel has queued the ack
+ * of a request before sendmsg() returns, so all the pending requests
+ * are answered or their acks were dropped because the receive buffer
+ * overran. When wait is set, we don't return with requests pending.
+ */
+static void
+netlink_cmd_read(bool wait)
+{
+	struct pollfd pfd = {
+		.fd = nl_cmd.fd,
+		.events = POLLIN
+	};
+	char buf[4096];
+	struct sockaddr_nl snl;
+	struct iovec iov = {
+		.iov_base = buf,
+		.iov_len = sizeof buf
+	};
+	struct msghdr msg = {
+		.msg_name = &snl,
+		.msg_namelen = sizeof(snl),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = NULL,
+		.msg_controllen = 0,
+		.msg_flags = 0
+	};
+	struct nlmsghdr *h;
+	bool overrun = false;
+	int status;
+
+	while (!LIST_ISEMPTY(nl_cmd_pending)) {
+		msg.msg_namelen = sizeof(snl);
+		msg.msg_flags = 0;
+		status = recvmsg(nl_cmd.fd, &msg, MSG_DONTWAIT);
+		if (status < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				log_message(LOG_INFO, "Netlink: Received message overrun (%m)");
+				overrun = true;
+				continue;
+			}
+			if (errno != EWOULDBLOCK && errno != EAGAIN)
+				log_message(LOG_INFO, "Netlink: recvmsg() error: %s",
+				       strerror(errno));
+			else if (wait && !overrun &&
+				 poll(&pfd, 1, NETLINK_TIMER / TIMER_HZ * 1000) > 0)
+				continue;
+			break;
+		}
+
+		if (status == 0) {
+			log_message(LOG_INFO, "Netlink: EOF");
+			break;
+		}
+
+		for (h = (struct nlmsghdr *) buf; NLMSG_OK(h, status);
+		     h = NLMSG_NEXT(h, status)) {
+			if (h->nlmsg_type == NLMSG_ERROR)
+				netlink_cmd_ack(h);
+			else
+				netlink_talk_filter(&snl, h);
+		}
+
+		if (msg.msg_flags & MSG_TRUNC)
+			log_message(LOG_INFO, "Netlink: error: message truncated");
+	}
+
+	if (overrun || wait)
+		netlink_cmd_fail(overrun ? -ENOBUFS : -ETIMEDOUT);
+}
+
+/* Wait for the acks of all the pending requests */
+void
+netlink_cmd_complete(void)
+{
+	if (LIST_ISEMPTY(nl_cmd_pending))
+		return;
+
+	netlink_cmd_read(true);
+
+	if (nl_cmd.thread) {
+		thread_cancel(nl_cmd.thread);
+		nl_cmd.thread = NULL;
+	}
+}
+
+/* Command channel read thread */
+static int
+kernel_netlink_cmd(thread_t * thread)
+{
+	nl_cmd.thread = NULL;
+
+	if (thread->type == THREAD_READ_TIMEOUT) {
+		if (!LIST_ISEMPTY(nl_cmd_pending))
+			log_message(LOG_INFO, "Netlink: no ack for %u requests",
+			       LIST_SIZE(nl_cmd_pending));
+		netlink_cmd_fail(-ETIMEDOUT);
+	} else
+		netlink_cmd_read(false);
+
+	if (!LIST_ISEMPTY(nl_cmd_pending))
+		nl_cmd.thread = thread_add_read(master, kernel_netlink_cmd, &nl_cmd,
+						nl_cmd.fd, NETLINK_TIMER);
+	return 0;
+}
+
+/* Send count requests on the command channel, without waiting */
+static int
+netlink_cmd_sendmsg(void *buf, size_t len, unsigned count)
+{
+	struct sockaddr_nl snl;
+	struct iovec iov = {
+		.iov_base = buf,
+		.iov_len = len
+	};
+	struct msghdr msg = {
+		.msg_name = &snl,
+		.msg_namelen = sizeof(snl),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = NULL,
+		.msg_controllen = 0,
+		.msg_flags = 0
+	};
+	int error;
+
+	memset(&snl, 0, sizeof snl);
+	snl.nl_family = AF_NETLINK;
+
+	/* Make room in the receive buffer for the new acks */
+	if (LIST_SIZE(nl_cmd_pending) + count > NETLINK_BATCH_MAX)
+		netlink_cmd_read(false);
+
+	if (sendmsg(nl_cmd.fd, &msg, 0) < 0) {
+		error = -errno;
+		log_message(LOG_INFO, "Netlink: sendmsg() error: %s",
+		       strerror(errno));
+		return error;
+	}
+
+	return 0;
+}
+
+/*
+ * Send a request on the command channel. Returns 1 once it is sent,
+ * done() is then called when its ack is read, or right away with the
+ * error if it couldn't be sent.
+ */
+int
+netlink_cmd_send(struct nlmsghdr *n, int cmd, void (*done) (void *, int, int), void *item)
+{
+	int error;
+
+	n->nlmsg_seq = ++nl_cmd.seq;
+
+	/* Request Netlink acknowledgement */
+	n->nlmsg_flags |= NLM_F_ACK;
+
+	if ((error = netlink_cmd_sendmsg(n, n->nlmsg_len, 1))) {
+		if (done)
+			done(item, cmd, error);
+		return -1;
+	}
+
+	netlink_cmd_pending_add(n, cmd, done, item);
+	return 1;
+}
+
+/* Batched requests, sent on the command channel with a single sendmsg() */
+void
+netlink_batch_init(nl_batch_t *batch, int cmd, void (*done) (void *, int, int))
+{
+	batch->done = done;
+	batch->cmd = cmd;
+	batch->count = 0;
+	batch->len = 0;
+}
+
+/* Queue a request, sending the batch first if it is full */
+int
+netlink_batch_add(nl_batch_t *batch, struct nlmsghdr *n, void *item)
+{
+	struct nlmsghdr *h;
+	size_t len = NLMSG_ALIGN(n->nlmsg_len);
+
+	if (len > NETLINK_BATCH_SIZE) {
+		log_message(LOG_INFO, "Netlink: request of %u bytes is too large for a batch",
+		       n->nlmsg_len);
+		return -1;
+	}
+
+	if (batch->count == NETLINK_BATCH_MAX ||
+	    batch->len + len > NETLINK_BATCH_SIZE)
+		netlink_batch_flush(batch);
+
+	h = (struct nlmsghdr *) (batch->buf + batch->len);
+	memcpy(h, n, n->nlmsg_len);
+	h->nlmsg_seq = ++nl_cmd.seq;
+	h->nlmsg_flags |= NLM_F_ACK;
+
+	batch->offset[batch->count] = batch->len;
+	batch->item[batch->count++] = item;
+	batch->len += len;
+
+	return 1;
+}
+
+/*
+ * Send the queued requests. done() is called for each when its ack is
+ * read, or right away with the error if they couldn't be sent.
+ */
+int
+netlink_batch_flush(nl_batch_t *batch)
+{
+	struct nlmsghdr *h;
+	unsigned i;
+	int error;
+
+	if (!batch->count)
+		return 0;
+
+	error = netlink_cmd_sendmsg(batch->buf, batch->len, batch->count);
+
+	for (i = 0; i < batch->count; i++) {
+		h = (struct nlmsghdr *) (batch->buf + batch->offset[i]);
+		if (error)
+			batch->done(batch->item[i], batch->cmd, error);
+		else
+			netlink_cmd_pending_add(h, batch->cmd, batch->done, batch->item[i]);
+	}
+
+	batch->count = 0;
+	batch->len = 0;
+
+	return error ? -1 : 0;
+}
+
 /* send message to netlink kernel socket, then receive response */
 int
 netlink_talk(nl_handle_t *nl, struct nlmsghdr *n)
@@ -662,6 +1018,10 @@ netlink_talk(nl_handle_t *nl, struct nlmsghdr *n)
 	memset(&snl, 0, sizeof snl);
 	snl.nl_family = AF_NETLINK;
 
+	/* The acks of asynchronous requests come first */
+	if (nl == &nl_cmd)
+		netlink_cmd_complete();
+
 	n->nlmsg_seq = ++nl->seq;
 
 	/* Request Netlink acknowledgement */
@@ -721,6 +1081,78 @@ netlink_request(nl_handle_t *nl, int family, int type)
 	return 0;
 }
 
+/* Fetch a single link, by ifindex or by name */
+static int
+netlink_request_link(nl_handle_t *nl, int ifindex, const char *name)
+{
+	int status;
+	struct sockaddr_nl snl;
+	struct {
+		struct nlmsghdr n;
+		struct ifinfomsg ifi;
+		char buf[64];
+	} req;
+
+	memset(&snl, 0, sizeof (snl));
+	snl.nl_family = AF_NETLINK;
+
+	memset(&req, 0, sizeof (req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof (struct ifinfomsg));
+	req.n.nlmsg_type = RTM_GETLINK;
+	/* The ack ends the reply */
+	req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+	req.n.nlmsg_seq = ++nl->seq;
+	req.ifi.ifi_family = AF_UNSPEC;
+	req.ifi.ifi_index = ifindex;
+	if (name)
+		addattr_l(&req.n, sizeof(req), IFLA_IFNAME, (void *) name, strlen(name) + 1);
+
+	status = sendto(nl->fd, (void *) &req, req.n.nlmsg_len
+			, 0, (struct sockaddr *) &snl, sizeof (snl));
+	if (status < 0) {
+		log_message(LOG_INFO, "Netlink: sendto() failed: %s",
+		       strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Fetch the addresses of a single link. Only kernels with strict checking
+ * of dump requests filter them, the others dump every address and the
+ * filter drops the ones of other links.
+ */
+static int
+netlink_request_addr(nl_handle_t *nl, int family, int ifindex)
+{
+	int status;
+	struct sockaddr_nl snl;
+	struct {
+		struct nlmsghdr n;
+		struct ifaddrmsg ifa;
+	} req;
+
+	memset(&snl, 0, sizeof (snl));
+	snl.nl_family = AF_NETLINK;
+
+	memset(&req, 0, sizeof (req));
+	req.n.nlmsg_len = sizeof (req);
+	req.n.nlmsg_type = RTM_GETADDR;
+	req.n.nlmsg_flags = NLM_F_ROOT | NLM_F_MATCH | NLM_F_REQUEST;
+	req.n.nlmsg_seq = ++nl->seq;
+	req.ifa.ifa_family = family;
+	req.ifa.ifa_index = ifindex;
+
+	status = sendto(nl->fd, (void *) &req, sizeof (req)
+			, 0, (struct sockaddr *) &snl, sizeof (snl));
+	if (status < 0) {
+		log_message(LOG_INFO, "Netlink: sendto() failed: %s",
+		       strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
 static int
 netlink_if_link_populate(interface_t *ifp, struct rtattr *tb[], struct ifinfomsg *ifi)
 {
@@ -781,10 +1213,8 @@ netlink_if_link_populate(interface_t *ifp, struct rtattr *tb[], struct ifinfomsg
 			parse_rtattr_nested(linkattr, IFLA_MACVLAN_MAX, linkinfo[IFLA_INFO_DATA]);
 
 			if (linkattr[IFLA_MACVLAN_MODE] &&
-			    *(int*)RTA_DATA(linkattr[IFLA_MACVLAN_MODE]) == MACVLAN_MODE_PRIVATE) {
-				ifp->base_ifindex = *(int*)RTA_DATA(tb[IFLA_LINK]);
-				ifp->vmac = true;
-			}
+			    *(int*)RTA_DATA(linkattr[IFLA_MACVLAN_MODE]) == MACVLAN_MODE_PRIVATE)
+				if_set_vmac(ifp, *(int*)RTA_DATA(tb[IFLA_LINK]));
 		}
 	}
 
@@ -840,7 +1270,7 @@ netlink_if_link_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 		return 0;
 
 	/* Skip it if already exist */
-	ifp = if_get_by_ifname(name);
+	ifp = if_find_by_ifname(name);
 	if (ifp) {
 #ifdef _HAVE_VRRP_VMAC_
 		if (!ifp->vmac)
@@ -867,9 +1297,69 @@ netlink_if_link_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	return 0;
 }
 
-/* Interfaces lookup bootstrap function */
+/* Have the kernel filter dumps on the request header */
+static void
+netlink_set_strict_check(nl_handle_t *nl)
+{
+#if defined SOL_NETLINK && defined NETLINK_GET_STRICT_CHK
+	int on = 1;
+
+	/* Older kernels just don't filter */
+	setsockopt(nl->fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK, &on, sizeof(on));
+#endif
+}
+
+/*
+ * Fetch a single interface, by ifindex or by name. When tracking is
+ * scoped, also fetch its addresses, and the base interface of a VMAC
+ * interface.
+ */
+static int
+netlink_link_get(nl_handle_t *nl, int ifindex, const char *name,
+		 int (*filter) (struct sockaddr_nl *, struct nlmsghdr *))
+{
+	interface_t *ifp;
+	int error_ignore = netlink_error_ignore;
+	int status;
+
+	/* Not finding it is no error */
+	netlink_error_ignore = ENODEV;
+	status = netlink_request_link(nl, ifindex, name);
+	if (status == 0)
+		status = netlink_parse_info(filter, nl, NULL);
+	netlink_error_ignore = error_ignore;
+	if (status < 0 || !netlink_scoped)
+		return status;
+
+	ifp = (name) ? if_find_by_ifname(name) : if_get_by_ifindex(ifindex);
+	if (!ifp)
+		return 0;
+
+	if (netlink_request_addr(nl, AF_INET, ifp->ifindex) < 0 ||
+	    netlink_parse_info(netlink_if_address_filter, nl, NULL) < 0 ||
+	    netlink_request_addr(nl, AF_INET6, ifp->ifindex) < 0 ||
+	    netlink_parse_info(netlink_if_address_filter, nl, NULL) < 0)
+		return -1;
+
+#ifdef _HAVE_VRRP_VMAC_
+	if (ifp->vmac && !if_get_by_ifindex(ifp->base_ifindex)) {
+		interface_t *ifp_base;
+
+		netlink_link_get(nl, ifp->base_ifindex, NULL, netlink_if_link_filter);
+		if ((ifp_base = if_get_by_ifindex(ifp->base_ifindex)))
+			ifp->flags = ifp_base->flags;
+	}
+#endif
+
+	return 0;
+}
+
+/*
+ * Interfaces lookup bootstrap function. Given a name, only
+ * that interface is fetched.
+ */
 int
-netlink_interface_lookup(void)
+netlink_interface_lookup(const char *name)
 {
 	nl_handle_t nlh;
 	int status = 0;
@@ -877,6 +1367,12 @@ netlink_interface_lookup(void)
 	if (netlink_socket(&nlh, 0, 0) < 0)
 		return -1;
 
+	if (name) {
+		netlink_set_strict_check(&nlh);
+		status = netlink_link_get(&nlh, 0, name, netlink_if_link_filter);
+		goto end_int;
+	}
+
 	/* Interface lookup */
 	if (netlink_request(&nlh, AF_PACKET, RTM_GETLINK) < 0) {
 		status = -1;
@@ -955,16 +1451,27 @@ netlink_reflect_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 		if (h->nlmsg_type == RTM_NEWLINK) {
 			char *name;
 			name = (char *) RTA_DATA(tb[IFLA_IFNAME]);
-			ifp = if_get_by_ifname(name);
+			ifp = if_find_by_ifname(name);
 			if (!ifp) {
+				/* Not one of the configured interfaces */
+				if (netlink_scoped)
+					return 0;
 				ifp = (interface_t *) MALLOC(sizeof(interface_t));
+				status = netlink_if_link_populate(ifp, tb, ifi);
+				if (status < 0) {
+					FREE(ifp);
+					return -1;
+				}
 				if_add_queue(ifp);
 			} else {
+				/* Same name, new ifindex */
+				if_hash_del(ifp);
 				memset(ifp, 0, sizeof(interface_t));
+				status = netlink_if_link_populate(ifp, tb, ifi);
+				if_hash_add(ifp);
+				if (status < 0)
+					return -1;
 			}
-			status = netlink_if_link_populate(ifp, tb, ifi);
-			if (status < 0)
-				return -1;
 		} else {
 			if (__test_bit(LOG_DETAIL_BIT, &debug))
 				log_message(LOG_INFO, "Unknown interface %s deleted", (char *)tb[IFLA_IFNAME]);
@@ -1012,6 +1519,46 @@ netlink_broadcast_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	return 0;
 }
 
+/* Reflected messages were lost, fetch the interfaces again */
+static void
+netlink_resync(void)
+{
+	nl_handle_t nlh;
+	element e;
+
+	log_message(LOG_INFO, "Netlink: resynchronizing interfaces after reflector overrun");
+
+	if (netlink_socket(&nlh, 0, 0) < 0)
+		return;
+
+	if (!netlink_scoped) {
+		if (netlink_request(&nlh, AF_PACKET, RTM_GETLINK) == 0)
+			netlink_parse_info(netlink_reflect_filter, &nlh, NULL);
+		netlink_close(&nlh);
+		netlink_address_lookup();
+		return;
+	}
+
+	/* By name, an interface may have been recreated meanwhile. This only
+	 * refreshes the tracked interfaces and re-adds their addresses, an
+	 * address removed during the overrun is not noticed. */
+	netlink_set_strict_check(&nlh);
+	for (e = LIST_HEAD(get_if_list()); e; ELEMENT_NEXT(e)) {
+		interface_t *ifp = ELEMENT_DATA(e);
+
+		if (netlink_link_get(&nlh, 0, ifp->ifname, netlink_reflect_filter) < 0 &&
+		    errno == ENODEV) {
+			/* Deleted meanwhile, its RTM_DELLINK was lost */
+#ifdef _HAVE_VRRP_VMAC_
+			if (!ifp->vmac)
+				if_vmac_reflect_flags(ifp->ifindex, 0);
+#endif
+			ifp->flags = 0;
+		}
+	}
+	netlink_close(&nlh);
+}
+
 static int
 kernel_netlink(thread_t * thread)
 {
@@ -1019,6 +1566,10 @@ kernel_netlink(thread_t * thread)
 
 	if (thread->type != THREAD_READ_TIMEOUT)
 		netlink_parse_info(netlink_broadcast_filter, nl, NULL);
+	if (nl->overrun) {
+		nl->overrun = false;
+		netlink_resync();
+	}
 	nl->thread = thread_add_read(master, kernel_netlink, nl, nl->fd,
 				      NETLINK_TIMER);
 	return 0;
@@ -1027,8 +1578,12 @@ kernel_netlink(thread_t * thread)
 void
 kernel_netlink_init(void)
 {
-	/* Start with a netlink address lookup */
-	netlink_address_lookup();
+	/*
+	 * Start with a netlink address lookup. When tracking is scoped,
+	 * addresses are fetched along with each interface.
+	 */
+	if (!netlink_scoped)
+		netlink_address_lookup();
 
 	/*
 	 * Prepare netlink kernel broadcast channel
@@ -1045,6 +1600,7 @@ kernel_netlink_init(void)
 		log_message(LOG_INFO, "Error while registering Kernel netlink reflector channel");
 
 	/* Prepare netlink command channel. */
+	nl_cmd_pending = alloc_list(free_nl_cmd_req, NULL);
 	netlink_socket(&nl_cmd, SOCK_NONBLOCK, 0);
 	if (nl_cmd.fd > 0)
 		log_message(LOG_INFO, "Registering Kernel netlink command channel");
@@ -1055,6 +1611,10 @@ kernel_netlink_init(void)
 void
 kernel_netlink_close(void)
 {
+	/* Requests still pending refer to data about to be released */
+	netlink_cmd_complete();
+	free_list(&nl_cmd_pending);
+
 	netlink_close(&nl_kernel);
 	netlink_close(&nl_cmd);
 }
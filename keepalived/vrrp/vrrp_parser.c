@@ -68,9 +68,6 @@ static_rules_handler(vector_t *strvec)
 static void
 vrrp_sync_group_handler(vector_t *strvec)
 {
-	list l;
-	element e;
-	vrrp_sgroup_t *sg;
 	char* gname;
 
 	if (vector_count(strvec) != 2) {
@@ -82,16 +79,10 @@ vrrp_sync_group_handler(vector_t *strvec)
 	gname = vector_slot(strvec, 1);
 
 	/* check group doesn't already exist */
-	if (!LIST_ISEMPTY(vrrp_data->vrrp_sync_group)) {
-		l = vrrp_data->vrrp_sync_group;
-		for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-			sg = ELEMENT_DATA(e);
-			if (!strcmp(gname,sg->gname)) {
-				log_message(LOG_INFO, "vrrp sync group %s already defined", gname);
-				skip_block();
-				return;
-			}
-		}
+	if (vrrp_sgroup_name_lookup(vrrp_data, gname)) {
+		log_message(LOG_INFO, "vrrp sync group %s already defined", gname);
+		skip_block();
+		return;
 	}
 
 	alloc_vrrp_sync_group(gname);
@@ -152,9 +143,6 @@ vrrp_gglobal_tracking_handler(vector_t *strvec)
 static void
 vrrp_handler(vector_t *strvec)
 {
-	list l;
-	element e;
-	vrrp_t *vrrp;
 	char *iname;
 
 	if (vector_count(strvec) != 2) {
@@ -166,16 +154,10 @@ vrrp_handler(vector_t *strvec)
 	iname = vector_slot(strvec,1);
 
 	/* Make sure the vrrp instance doesn't already exist */
-	if (!LIST_ISEMPTY(vrrp_data->vrrp)) {
-		l = vrrp_data->vrrp;
-		for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-			vrrp = ELEMENT_DATA(e);
-			if (!strcmp(iname,vrrp->iname)) {
-				log_message(LOG_INFO, "vrrp instance %s already defined", iname );
-				skip_block();
-				return;
-			}
-		}
+	if (vrrp_name_lookup(vrrp_data, iname)) {
+		log_message(LOG_INFO, "vrrp instance %s already defined", iname );
+		skip_block();
+		return;
 	}
 
 	alloc_vrrp(iname);
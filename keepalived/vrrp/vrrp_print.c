@@ -381,6 +381,17 @@ vrrp_print_stats(void)
 	list l = vrrp_data->vrrp;
 	element e;
 	vrrp_t *vrrp;
+	thread_alloc_stats_t sched_stats;
+
+	thread_get_alloc_stats(master, &sched_stats);
+	fprintf(file, "Scheduler:\n");
+	fprintf(file, "  Threads allocated: %lu\n", sched_stats.alloc);
+	fprintf(file, "  Threads in use: %lu\n", sched_stats.in_use);
+	fprintf(file, "  Threads pooled: %lu\n", sched_stats.pooled);
+	fprintf(file, "  Thread chunks: %lu\n", sched_stats.chunks);
+#ifdef _WITH_THREAD_STATS_
+	thread_dump_stats(master, file);
+#endif
 
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
 		vrrp = ELEMENT_DATA(e);
@@ -388,6 +399,7 @@ vrrp_print_stats(void)
 		fprintf(file, "  Advertisements:\n");
 		fprintf(file, "    Received: %" PRIu64 "\n", vrrp->stats->advert_rcvd);
 		fprintf(file, "    Sent: %d\n", vrrp->stats->advert_sent);
+		fprintf(file, "    Send Errors: %d\n", vrrp->stats->advert_send_err);
 		fprintf(file, "  Became master: %d\n", vrrp->stats->become_master);
 		fprintf(file, "  Released master: %d\n",
 			vrrp->stats->release_master);
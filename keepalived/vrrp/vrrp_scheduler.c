@@ -342,58 +342,51 @@ vrrp_init_script(list l)
 
 /* Timer functions */
 static timeval_t
-vrrp_compute_timer(const int fd)
+vrrp_compute_timer(sock_t *sock)
 {
-	vrrp_t *vrrp;
-	element e;
-	list l = &vrrp_data->vrrp_index_fd[fd%1024 + 1];
+	vrrp_t *vrrp = vrrp_sock_sands_min(sock);
 	timeval_t timer;
 
-	/* Multiple instances on the same interface */
-	timer_reset(timer);
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		vrrp = ELEMENT_DATA(e);
-		if (timer_cmp(vrrp->sands, timer) < 0 ||
-		    timer_isnull(timer))
-			timer = timer_dup(vrrp->sands);
-	}
+	/* Multiple instances on the same interface, earliest first */
+	if (vrrp)
+		return vrrp->sands;
 
+	timer_reset(timer);
 	return timer;
 }
 
 static long
-vrrp_timer_fd(const int fd)
+vrrp_timer_fd(sock_t *sock)
 {
 	timeval_t timer, vrrp_timer;
 	long vrrp_long;
 
-	timer = vrrp_compute_timer(fd);
+	timer = vrrp_compute_timer(sock);
 	vrrp_timer = timer_sub(timer, time_now);
 	vrrp_long = timer_long(vrrp_timer);
 
 	return (vrrp_long < 0) ? TIMER_MAX_SEC : vrrp_long;
 }
 
-static int
-vrrp_timer_vrid_timeout(const int fd)
+/* Register the dispatcher thread of a socket. Adverts and master down
+ * timers are driven from it, so it is dispatched ahead of bulk work.
+ * The read registration persists, later only its timeout is moved. */
+static void
+vrrp_register_dispatcher(sock_t *sock, int fd, long vrrp_timer)
 {
-	vrrp_t *vrrp;
-	element e;
-	list l = &vrrp_data->vrrp_index_fd[fd%1024 + 1];
-	timeval_t timer;
-	int vrid = 0;
-
-	/* Multiple instances on the same interface */
-	timer_reset(timer);
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		vrrp = ELEMENT_DATA(e);
-		if (timer_cmp(vrrp->sands, timer) < 0 ||
-		    timer_isnull(timer)) {
-			timer = timer_dup(vrrp->sands);
-			vrid = vrrp->vrid;
-		}
+	if (sock->thread) {
+		thread_set_read_timer(sock->thread, vrrp_timer);
+		return;
 	}
-	return vrid;
+
+	/* Register a timer thread if interface is shut */
+	if (fd == -1)
+		sock->thread = thread_add_timer(master, vrrp_read_dispatcher_thread,
+						sock, vrrp_timer);
+	else
+		sock->thread = thread_add_read_persistent(master, vrrp_read_dispatcher_thread,
+							  sock, fd, vrrp_timer);
+	thread_set_priority(sock->thread, THREAD_PRIORITY_HIGH);
 }
 
 /* Thread functions */
@@ -411,7 +404,8 @@ vrrp_register_workers(list l)
 	/* Init the VRRP instances state */
 	vrrp_init_state(vrrp_data->vrrp);
 
-	/* Init VRRP instances sands */
+	/* Init VRRP instances sands, from the time startup completed */
+	set_time_now();
 	vrrp_init_sands(vrrp_data->vrrp);
 
 	/* Init VRRP tracking scripts */
@@ -422,20 +416,23 @@ vrrp_register_workers(list l)
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
 		sock = ELEMENT_DATA(e);
 		/* jump to asynchronous handling */
-		vrrp_timer = vrrp_timer_fd(sock->fd_in);
+		vrrp_timer = vrrp_timer_fd(sock);
 
-		/* Register a timer thread if interface is shut */
-		if (sock->fd_in == -1)
-			sock->thread = thread_add_timer(master, vrrp_read_dispatcher_thread,
-							sock, vrrp_timer);
-		else
-			sock->thread = thread_add_read(master, vrrp_read_dispatcher_thread,
-						       sock, sock->fd_in, vrrp_timer);
+		vrrp_register_dispatcher(sock, sock->fd_in, vrrp_timer);
 	}
 }
 
 /* VRRP dispatcher functions */
-static int
+/* Buckets of the socket pool hash, used while the pool is built */
+#define VRRP_SOCK_INDEX_SIZE	256
+
+static unsigned
+vrrp_sock_hash(sa_family_t family, int proto, int ifindex, int unicast)
+{
+	return (ifindex * 31 + proto * 7 + family * 2 + unicast) & (VRRP_SOCK_INDEX_SIZE - 1);
+}
+
+static sock_t *
 already_exist_sock(list l, sa_family_t family, int proto, int ifindex, int unicast)
 {
 	sock_t *sock;
@@ -447,12 +444,12 @@ already_exist_sock(list l, sa_family_t family, int proto, int ifindex, int unica
 		    (sock->proto == proto)	&&
 		    (sock->ifindex == ifindex)	&&
 		    (sock->unicast == unicast))
-			return 1;
+			return sock;
 	}
-	return 0;
+	return NULL;
 }
 
-static void
+static sock_t *
 alloc_sock(sa_family_t family, list l, int proto, int ifindex, int unicast)
 {
 	sock_t *new;
@@ -464,16 +461,26 @@ alloc_sock(sa_family_t family, list l, int proto, int ifindex, int unicast)
 	new->unicast = unicast;
 
 	list_add(l, new);
+	return new;
 }
 
+/*
+ * Create the socket pool and append each instance to the sands heap of
+ * its socket. The sockets are looked up through a hash keyed like the
+ * pool, so that this is linear in the number of instances.
+ */
 static void
 vrrp_create_sockpool(list l)
 {
 	vrrp_t *vrrp;
+	sock_t *sock;
 	list p = vrrp_data->vrrp;
+	list index, bucket;
 	element e;
 	int ifindex, proto, unicast;
 
+	index = alloc_mlist(NULL, NULL, VRRP_SOCK_INDEX_SIZE);
+
 	for (e = LIST_HEAD(p); e; ELEMENT_NEXT(e)) {
 		vrrp = ELEMENT_DATA(e);
 		ifindex =
@@ -490,9 +497,18 @@ vrrp_create_sockpool(list l)
 			proto = IPPROTO_VRRP;
 
 		/* add the vrrp element if not exist */
-		if (!already_exist_sock(l, vrrp->family, proto, ifindex, unicast))
-			alloc_sock(vrrp->family, l, proto, ifindex, unicast);
+		bucket = &index[vrrp_sock_hash(vrrp->family, proto, ifindex, unicast)];
+		sock = already_exist_sock(bucket, vrrp->family, proto, ifindex, unicast);
+		if (!sock) {
+			sock = alloc_sock(vrrp->family, l, proto, ifindex, unicast);
+			list_add(bucket, sock);
+		}
+
+		/* append to the socket sands heap */
+		alloc_vrrp_sock_sands(sock, vrrp);
 	}
+
+	free_mlist(index, VRRP_SOCK_INDEX_SIZE);
 }
 
 static void
@@ -517,40 +533,14 @@ static void
 vrrp_set_fds(list l)
 {
 	sock_t *sock;
-	vrrp_t *vrrp;
-	list p = vrrp_data->vrrp;
-	element e_sock;
-	element e_vrrp;
-	int proto, ifindex, unicast;
-
-	for (e_sock = LIST_HEAD(l); e_sock; ELEMENT_NEXT(e_sock)) {
-		sock = ELEMENT_DATA(e_sock);
-		for (e_vrrp = LIST_HEAD(p); e_vrrp; ELEMENT_NEXT(e_vrrp)) {
-			vrrp = ELEMENT_DATA(e_vrrp);
-			ifindex =
-#ifdef _HAVE_VRRP_VMAC_
-				  (__test_bit(VRRP_VMAC_XMITBASE_BIT, &vrrp->vmac_flags)) ? IF_BASE_INDEX(vrrp->ifp) :
-#endif
-											    IF_INDEX(vrrp->ifp);
-			unicast = !LIST_ISEMPTY(vrrp->unicast_peer);
-#if defined _WITH_VRRP_AUTH_
-			if (vrrp->version == VRRP_VERSION_2 && vrrp->auth_type == VRRP_AUTH_AH)
-				proto = IPPROTO_IPSEC_AH;
-			else
-#endif
-				proto = IPPROTO_VRRP;
+	element e;
 
-			if ((sock->ifindex == ifindex)	&&
-		(sock->family == vrrp->family) &&
-			    (sock->proto == proto)	&&
-			    (sock->unicast == unicast)) {
-				vrrp->fd_in = sock->fd_in;
-				vrrp->fd_out = sock->fd_out;
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		sock = ELEMENT_DATA(e);
+		set_vrrp_sock_fds(sock);
 
-				/* append to hash index */
-				alloc_vrrp_fd_bucket(vrrp);
-			}
-		}
+		/* only queue adverts for the instances on this socket */
+		set_vrrp_sock_filter(sock);
 	}
 }
 
@@ -929,17 +919,11 @@ vrrp_fault(vrrp_t * vrrp)
 }
 
 /* Handle dispatcher read timeout */
-static int
-vrrp_dispatcher_read_timeout(int fd)
+static void
+vrrp_dispatcher_timeout(vrrp_t *vrrp)
 {
-	vrrp_t *vrrp;
-	int vrid = 0;
 	int prev_state = 0;
 
-	/* Searching for matching instance */
-	vrid = vrrp_timer_vrid_timeout(fd);
-	vrrp = vrrp_index_lookup(vrid, fd);
-
 	/* Run the FSM handler */
 	prev_state = vrrp->state;
 	VRRP_FSM_READ_TO(vrrp);
@@ -965,42 +949,89 @@ vrrp_dispatcher_read_timeout(int fd)
 	 */
 	if (vrrp->quick_sync) {
 		vrrp->sands = timer_add_long(time_now, vrrp->adver_int);
+		update_vrrp_sock_sands(vrrp);
 		vrrp->quick_sync = 0;
 	}
-
-	return vrrp->fd_in;
 }
 
-/* Handle dispatcher read packet */
+/*
+ * With vrrp_tx_coalesce set, the instances on the socket that are
+ * due, and the masters due within the window, are handled in this
+ * wakeup too. Their adverts are queued and go out together.
+ */
 static int
-vrrp_dispatcher_read(sock_t * sock)
+vrrp_dispatcher_read_timeout(sock_t *sock)
 {
+	timeval_t window;
 	vrrp_t *vrrp;
-	vrrphdr_t *hd;
-	int len = 0, prev_state = 0, proto = 0;
-	struct sockaddr_storage src_addr;
-	socklen_t src_addr_len = sizeof(src_addr);
+	unsigned n;
+
+	/* The instance timing out first */
+	vrrp = vrrp_sock_sands_min(sock);
+	if (!vrrp)
+		return sock->fd_in;
+
+	if (!global_data->vrrp_tx_coalesce) {
+		vrrp_dispatcher_timeout(vrrp);
+		return vrrp->fd_in;
+	}
+
+	window = timer_add_long(time_now, global_data->vrrp_tx_coalesce);
+#ifdef _HAVE_SENDMMSG_
+	sock->tx_queueing = true;
+#endif
 
-	/* Clean the read buffer */
-	memset(vrrp_buffer, 0, vrrp_buffer_len);
+	/* Each instance at most once, in case adver_int is within the window */
+	for (n = sock->sands_count; n && vrrp; n--) {
+		vrrp_dispatcher_timeout(vrrp);
 
-	/* read & affect received buffer */
-	len = recvfrom(sock->fd_in, vrrp_buffer, vrrp_buffer_len, 0,
-		       (struct sockaddr *) &src_addr, &src_addr_len);
-	hd = vrrp_get_header(sock->family, vrrp_buffer, &proto);
+		vrrp = vrrp_sock_sands_min(sock);
+		if (vrrp && timer_cmp(vrrp->sands, time_now) > 0 &&
+		    (vrrp->state != VRRP_STATE_MAST || timer_cmp(vrrp->sands, window) > 0))
+			break;
+	}
+
+#ifdef _HAVE_SENDMMSG_
+	sock->tx_queueing = false;
+	vrrp_send_queued(sock);
+#endif
+
+	return sock->fd_in;
+}
+
+/*
+ * Bytes parsed to find the instance before the packet length is checked:
+ * the largest IPv4 header, the IPSEC AH header and the VRRP header.
+ */
+#define VRRP_RX_HDR_LEN	(60 + sizeof(ipsec_ah_t) + sizeof(vrrphdr_t))
+
+/* Handle a received packet */
+static void
+vrrp_dispatcher_packet(sock_t * sock, char *buffer, int len,
+		       struct sockaddr_storage *src_addr)
+{
+	vrrp_t *vrrp;
+	vrrphdr_t *hd;
+	int prev_state = 0, proto = 0;
+	size_t hdr_len = (VRRP_RX_HDR_LEN < vrrp_buffer_len) ? VRRP_RX_HDR_LEN : vrrp_buffer_len;
+
+	/* A short packet must not be parsed with a previous packet tail */
+	if ((size_t) len < hdr_len)
+		memset(buffer + len, 0, hdr_len - len);
+	hd = vrrp_get_header(sock->family, buffer, &proto);
 
 	/* Searching for matching instance */
 	vrrp = vrrp_index_lookup(hd->vrid, sock->fd_in);
 
 	/* If no instance found => ignore the advert */
 	if (!vrrp)
-		return sock->fd_in;
+		return;
 
-	vrrp->pkt_saddr = src_addr;
+	vrrp->pkt_saddr = *src_addr;
 
 	/* Run the FSM handler */
 	prev_state = vrrp->state;
-	VRRP_FSM_READ(vrrp, vrrp_buffer, len);
+	VRRP_FSM_READ(vrrp, buffer, len);
 
 	/* handle instance synchronization */
 //	printf("Read [%s] TSM transtition : [%d,%d] Wantstate = [%d]\n"
@@ -1015,6 +1046,51 @@ vrrp_dispatcher_read(sock_t * sock)
 	 * Otherwize the packet is simply ignored...
 	 */
 	vrrp_init_instance_sands(vrrp);
+}
+
+/* Handle dispatcher read packets, draining up to VRRP_RX_BATCH at once */
+static int
+vrrp_dispatcher_read(sock_t * sock)
+{
+	struct sockaddr_storage src_addr[VRRP_RX_BATCH];
+	int fd = sock->fd_in;
+	int i, count;
+#ifdef _HAVE_RECVMMSG_
+	struct mmsghdr msgs[VRRP_RX_BATCH];
+	struct iovec iovs[VRRP_RX_BATCH];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < VRRP_RX_BATCH; i++) {
+		iovs[i].iov_base = vrrp_buffer + i * vrrp_buffer_len;
+		iovs[i].iov_len = vrrp_buffer_len;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &src_addr[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(src_addr[i]);
+	}
+
+	/* read the adverts already queued, without waiting for more */
+	count = recvmmsg(fd, msgs, VRRP_RX_BATCH, MSG_DONTWAIT, NULL);
+#else
+	int len;
+	socklen_t src_addr_len = sizeof(src_addr[0]);
+
+	len = recvfrom(fd, vrrp_buffer, vrrp_buffer_len, 0,
+		       (struct sockaddr *) &src_addr[0], &src_addr_len);
+	count = (len < 0) ? -1 : 1;
+#endif
+
+	for (i = 0; i < count; i++) {
+		/* The socket was reopened, the rest of the batch is stale */
+		if (sock->fd_in != fd)
+			break;
+#ifdef _HAVE_RECVMMSG_
+		vrrp_dispatcher_packet(sock, vrrp_buffer + i * vrrp_buffer_len,
+				       msgs[i].msg_len, &src_addr[i]);
+#else
+		vrrp_dispatcher_packet(sock, vrrp_buffer, len, &src_addr[0]);
+#endif
+	}
 
 	return sock->fd_in;
 }
@@ -1030,20 +1106,19 @@ vrrp_read_dispatcher_thread(thread_t * thread)
 	/* Fetch thread arg */
 	sock = THREAD_ARG(thread);
 
+	/* Only the read registration outlives its dispatch */
+	if (thread->type == THREAD_READY)
+		sock->thread = NULL;
+
 	/* Dispatcher state handler */
 	if (thread->type == THREAD_READ_TIMEOUT || sock->fd_in == -1)
-		fd = vrrp_dispatcher_read_timeout(sock->fd_in);
+		fd = vrrp_dispatcher_read_timeout(sock);
 	else
 		fd = vrrp_dispatcher_read(sock);
 
 	/* register next dispatcher thread */
-	vrrp_timer = vrrp_timer_fd(fd);
-	if (fd == -1)
-		sock->thread = thread_add_timer(thread->master, vrrp_read_dispatcher_thread,
-						sock, vrrp_timer);
-	else
-		sock->thread = thread_add_read(thread->master, vrrp_read_dispatcher_thread,
-					       sock, fd, vrrp_timer);
+	vrrp_timer = vrrp_timer_fd(sock);
+	vrrp_register_dispatcher(sock, fd, vrrp_timer);
 
 	return 0;
 }
@@ -1083,7 +1158,7 @@ vrrp_script_child_thread(thread_t * thread)
 				log_message(LOG_INFO, "VRRP_Script(%s) timed out", vscript->sname);
 			vscript->result = 0;
 		}
-		kill(pid, SIGTERM);
+		thread_child_kill(thread, SIGTERM);
 		thread_add_child(thread->master, vrrp_script_child_timeout_thread,
 				 vscript, pid, 2);
 		return 0;
@@ -1128,7 +1203,7 @@ vrrp_script_child_timeout_thread(thread_t * thread)
 
 	/* OK, it still hasn't exited. Now really kill it off. */
 	pid = THREAD_CHILD_PID(thread);
-	if (kill(pid, SIGKILL) < 0) {
+	if (thread_child_kill(thread, SIGKILL) < 0) {
 		/* Its possible it finished while we're handing this */
 		if (errno != ESRCH)
 			DBG("kill error: %s", strerror(errno));
@@ -1140,86 +1215,58 @@ vrrp_script_child_timeout_thread(thread_t * thread)
 	return 0;
 }
 
-/* Delayed ARP/NA thread */
-int
-vrrp_arp_thread(thread_t *thread)
+/* Send the addresses of an interface queue whose turn has come */
+static void
+vrrp_arp_send_queue(garp_delay_t *delay, list l, bool ipv6, timeval_t *next_time)
 {
-	element e, a;
-	list l;
+	timeval_t *if_next_time = ipv6 ? &delay->gna_next_time : &delay->garp_next_time;
 	ip_address_t *ipaddress;
-	timeval_t next_time = {
-		.tv_sec = INT_MAX	/* We're never going to delay this long - I hope! */
-	};
-	interface_t *ifp;
-	vrrp_t *vrrp;
-	enum {
-		VIP,
-		EVIP
-	} i;
-
-	set_time_now();
-
-	for (e = LIST_HEAD(vrrp_data->vrrp); e; ELEMENT_NEXT(e)) {
-		vrrp = ELEMENT_DATA(e);
-
-		if (!vrrp->garp_pending && !vrrp->gna_pending)
-			continue;
+	element e;
 
-		vrrp->garp_pending = false;
-		vrrp->gna_pending = false;
+	while ((e = LIST_HEAD(l))) {
+		ipaddress = ELEMENT_DATA(e);
 
-		if (vrrp->state != VRRP_STATE_MAST ||
-		    !vrrp->vipset)
-			continue;
+		/* Cancelled, or the address has gone since */
+		if (ipaddress->garp_gna_pending && ipaddress->set) {
+			if (timer_cmp(time_now, *if_next_time) < 0) {
+				if (timer_cmp(*if_next_time, *next_time) < 0)
+					*next_time = *if_next_time;
+				return;
+			}
 
-		for (i = VIP; i <= EVIP; i++) {
-			l = (i == VIP) ? vrrp->vip : vrrp->evip;
+			if (ipv6)
+				ndisc_send_unsolicited_na_immediate(IF_BASE_IFP(ipaddress->ifp), ipaddress);
+			else
+				send_gratuitous_arp_immediate(IF_BASE_IFP(ipaddress->ifp), ipaddress);
+		}
 
-			if (!LIST_ISEMPTY(l)) {
-				for (a = LIST_HEAD(l); a; ELEMENT_NEXT(a)) {
-					ipaddress = ELEMENT_DATA(a);
-					if (!ipaddress->garp_gna_pending)
-						continue;
-					if (!ipaddress->set) {
-						ipaddress->garp_gna_pending = false;
-						continue;
-					}
+		ipaddress->garp_gna_pending = false;
+		free_list_element(l, e);
+	}
+}
 
-					ifp = IF_BASE_IFP(ipaddress->ifp);
+/* Delayed ARP/NA thread */
+int
+vrrp_arp_thread(thread_t *thread)
+{
+	element e;
+	garp_delay_t *delay;
+	timeval_t next_time = {
+		.tv_sec = INT_MAX	/* We're never going to delay this long - I hope! */
+	};
 
-					/* This should never happen */
-					if (!ifp->garp_delay) {
-						ipaddress->garp_gna_pending = false;
-						continue;
-					}
+	/* Only the interfaces with addresses waiting for their turn */
+	for (e = LIST_ISEMPTY(garp_delay) ? NULL : LIST_HEAD(garp_delay); e; ELEMENT_NEXT(e)) {
+		delay = ELEMENT_DATA(e);
 
-					if (!IP_IS6(ipaddress)) {
-						if (timer_cmp(time_now, ifp->garp_delay->garp_next_time) >= 0) {
-							send_gratuitous_arp_immediate(ifp, ipaddress);
-							ipaddress->garp_gna_pending = false;
-						}
-						else {
-							vrrp->garp_pending = true;
-							if (timer_cmp(ifp->garp_delay->garp_next_time, next_time) < 0)
-								next_time = ifp->garp_delay->garp_next_time;
-						}
-					}
-					else {
-						if (timer_cmp(time_now, ifp->garp_delay->gna_next_time) >= 0) {
-							ndisc_send_unsolicited_na_immediate(ifp, ipaddress);
-							ipaddress->garp_gna_pending = false;
-						}
-						else {
-							vrrp->gna_pending = true;
-							if (timer_cmp(ifp->garp_delay->gna_next_time, next_time) < 0)
-								next_time = ifp->garp_delay->gna_next_time;
-						}
-					}
-				}
-			}
-		}
+		if (!LIST_ISEMPTY(delay->garp_queue))
+			vrrp_arp_send_queue(delay, delay->garp_queue, false, &next_time);
+		if (!LIST_ISEMPTY(delay->gna_queue))
+			vrrp_arp_send_queue(delay, delay->gna_queue, true, &next_time);
 	}
 
+	garp_gna_send_queued();
+
 	if (next_time.tv_sec != INT_MAX) {
 		/* Register next timer tracker */
 		garp_next_time = next_time;
@@ -24,6 +24,7 @@
 #include "vrrp_if.h"
 #include "vrrp_notify.h"
 #include "vrrp_data.h"
+#include "vrrp_index.h"
 #ifdef _WITH_SNMP_
   #include "vrrp_snmp.h"
 #endif
@@ -34,8 +35,6 @@
 void
 vrrp_init_instance_sands(vrrp_t * vrrp)
 {
-	set_time_now();
-
 	if (vrrp->state == VRRP_STATE_MAST	  ||
 	    vrrp->state == VRRP_STATE_GOTO_MASTER ||
 	    vrrp->state == VRRP_STATE_GOTO_FAULT  ||
@@ -45,6 +44,7 @@ vrrp_init_instance_sands(vrrp_t * vrrp)
 // ii) backup and receive prio 0
 // iii) master and receive higher prio advert
 		vrrp->sands = timer_add_long(time_now, vrrp->adver_int);
+		update_vrrp_sock_sands(vrrp);
 		return;
 	}
 
@@ -54,24 +54,10 @@ vrrp_init_instance_sands(vrrp_t * vrrp)
 	 * received. (When a preemptable packet is received, the wantstate is
 	 * moved to GOTO_MASTER and this condition is caught above).
 	 */
-	if (vrrp->state == VRRP_STATE_BACK || vrrp->state == VRRP_STATE_FAULT)
+	if (vrrp->state == VRRP_STATE_BACK || vrrp->state == VRRP_STATE_FAULT) {
 		vrrp->sands = timer_add_long(time_now, vrrp->ms_down_timer);
-}
-
-/* Instance name lookup */
-static vrrp_t *
-vrrp_get_instance(char *iname)
-{
-	vrrp_t *vrrp;
-	list l = vrrp_data->vrrp;
-	element e;
-
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		vrrp = ELEMENT_DATA(e);
-		if (strcmp(vrrp->iname, iname) == 0)
-			return vrrp;
+		update_vrrp_sock_sands(vrrp);
 	}
-	return NULL;
 }
 
 /* Set instances group pointer */
@@ -91,7 +77,7 @@ vrrp_sync_set_group(vrrp_sgroup_t *vgroup)
 
 	for (i = 0; i < vector_size(vgroup->iname); i++) {
 		str = vector_slot(vgroup->iname, i);
-		vrrp = vrrp_get_instance(str);
+		vrrp = vrrp_name_lookup(vrrp_data, str);
 		if (vrrp) {
 			if (vrrp->sync)
 				log_message(LOG_INFO, "Virtual router %s cannot exist in more than one sync group; ignoring %s", str, vgroup->gname);
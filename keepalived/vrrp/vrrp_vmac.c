@@ -31,6 +31,7 @@
 #include "vrrp_netlink.h"
 #include "vrrp_data.h"
 #include "logger.h"
+#include "memory.h"
 #include "bitops.h"
 #include "vrrp_if_config.h"
 #include "vrrp_ipaddress.h"
@@ -55,10 +56,17 @@ make_link_local_address(struct in6_addr* l3_addr, const u_char* ll_addr)
 	l3_addr->s6_addr[15] = ll_addr[5];
 }
 
+/* Log the failure of a request sent without waiting for its ack */
+static void
+netlink_vmac_done(void *item, int cmd, int error)
+{
+	if (error)
+		log_message(LOG_INFO, "%s", (char *) item);
+}
+
 static int
 netlink_link_up(vrrp_t *vrrp)
 {
-	int status = 1;
 	struct {
 		struct nlmsghdr n;
 		struct ifinfomsg ifi;
@@ -75,10 +83,8 @@ netlink_link_up(vrrp_t *vrrp)
 	req.ifi.ifi_change |= IFF_UP;
 	req.ifi.ifi_flags |= IFF_UP;
 
-	if (netlink_talk(&nl_cmd, &req.n) < 0)
-		status = -1;
-
-	return status;
+	return netlink_cmd_send(&req.n, 0, netlink_vmac_done,
+				"vmac: Error bringing VMAC interface up");
 }
 
 int
@@ -179,7 +185,7 @@ netlink_link_add_vmac(vrrp_t *vrrp)
 	/*
 	 * Update interface queue and vrrp instance interface binding.
 	 */
-	netlink_interface_lookup();
+	netlink_interface_lookup(ifname);
 	ifp = if_get_by_ifname(ifname);
 	if (!ifp)
 		return -1;
@@ -187,8 +193,7 @@ netlink_link_add_vmac(vrrp_t *vrrp)
 	base_ifindex = vrrp->ifp->ifindex;
 	ifp->flags = vrrp->ifp->flags; /* Copy base interface flags */
 	vrrp->ifp = ifp;
-	vrrp->ifp->base_ifindex = base_ifindex;
-	vrrp->ifp->vmac = 1;
+	if_set_vmac(vrrp->ifp, base_ifindex);
 	vrrp->vmac_ifindex = IF_INDEX(vrrp->ifp); /* For use on delete */
 
 	if (vrrp->family == AF_INET) {
@@ -224,8 +229,8 @@ netlink_link_add_vmac(vrrp_t *vrrp)
 		data->rta_len = (void *)NLMSG_TAIL(&req.n) - (void *)data;
 		spec->rta_len = (void *)NLMSG_TAIL(&req.n) - (void *)spec;
 
-		if (netlink_talk(&nl_cmd, &req.n) < 0)
-			log_message(LOG_INFO, "vmac: Error setting ADDR_GEN_MODE to NONE");
+		netlink_cmd_send(&req.n, 0, netlink_vmac_done,
+				 "vmac: Error setting ADDR_GEN_MODE to NONE");
 #endif
 
 		if (vrrp->family == AF_INET6) {
@@ -290,12 +295,25 @@ netlink_link_add_vmac(vrrp_t *vrrp)
 	return 1;
 }
 
+static void
+netlink_link_del_vmac_done(void *item, int cmd, int error)
+{
+	char *name = item;
+
+	if (error)
+		log_message(LOG_INFO, "vmac: Error removing %s!!!", name);
+	else
+		log_message(LOG_INFO, "vmac: Success removing %s", name);
+
+	FREE(name);
+}
+
 int
 netlink_link_del_vmac(vrrp_t *vrrp)
 {
-	int status = 1;
-
 	interface_t *base_ifp ;
+	char *name;
+	size_t len;
 	struct {
 		struct nlmsghdr n;
 		struct ifinfomsg ifi;
@@ -323,14 +341,11 @@ netlink_link_del_vmac(vrrp_t *vrrp)
 	req.ifi.ifi_family = AF_INET;
 	req.ifi.ifi_index = vrrp->vmac_ifindex;
 
-	if (netlink_talk(&nl_cmd, &req.n) < 0) {
-		log_message(LOG_INFO, "vmac: Error removing VMAC interface %s for vrrp_instance %s!!!"
-				    , vrrp->vmac_ifname, vrrp->iname);
-		return -1;
-	}
-
-	log_message(LOG_INFO, "vmac: Success removing VMAC interface %s for vrrp_instance %s"
-			    , vrrp->vmac_ifname, vrrp->iname);
+	/* The instance may be gone when the ack is read, keep its names */
+	len = strlen(vrrp->vmac_ifname) + strlen(vrrp->iname) + 40;
+	name = (char *) MALLOC(len);
+	snprintf(name, len, "VMAC interface %s for vrrp_instance %s",
+		 vrrp->vmac_ifname, vrrp->iname);
 
-	return status;
+	return netlink_cmd_send(&req.n, 0, netlink_link_del_vmac_done, name);
 }
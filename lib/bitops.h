@@ -69,6 +69,7 @@ enum global_bits {
 #ifdef _MEM_CHECK_LOG_
 	MEM_CHECK_LOG_BIT = 9,
 #endif
+	SCOPED_NETLINK_BIT = 10,
 };
 
 #endif
@@ -35,9 +35,18 @@
 #define NDEBUG
 #endif
 #include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include <signal.h>
 #include <sys/wait.h>
 #include <sys/select.h>
+#ifdef _HAVE_EPOLL_
+#include <sys/epoll.h>
+#endif
+#ifdef _HAVE_PIDFD_
+#include <sys/syscall.h>
+#endif
 #include <unistd.h>
 #include "scheduler.h"
 #include "memory.h"
@@ -93,6 +102,203 @@ report_child_status(int status, pid_t pid, const char *prog_name)
 	return false;
 }
 
+#ifdef _HAVE_EPOLL_
+/* Create the epoll set backing the master I/O threads */
+static void
+thread_io_init(thread_master_t * m)
+{
+	m->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (m->epoll_fd < 0)
+		log_message(LOG_INFO, "scheduler: epoll_create1 error (%s)", strerror(errno));
+
+	m->epoll_events = MALLOC(THREAD_EPOLL_EVENTS * sizeof(struct epoll_event));
+	m->signal_fd = -1;
+	m->timeout_pidfd = -1;
+}
+
+/*
+ * Release the epoll set. This never calls epoll_ctl(), since after a
+ * fork() the epoll set is shared with the parent process and any
+ * change would affect the parent registrations.
+ */
+static void
+thread_io_release(thread_master_t * m)
+{
+	if (m->epoll_fd >= 0)
+		close(m->epoll_fd);
+	m->epoll_fd = -1;
+	if (m->timeout_pidfd >= 0)
+		close(m->timeout_pidfd);
+	m->timeout_pidfd = -1;
+	FREE_PTR(m->epoll_events);
+	FREE_PTR(m->io_events);
+	m->io_events_size = 0;
+}
+
+/* Return fd I/O registration, growing the fd table if needed */
+static thread_event_t *
+thread_io_event(thread_master_t * m, int fd)
+{
+	int size;
+
+	if (fd >= m->io_events_size) {
+		size = m->io_events_size ? m->io_events_size : 64;
+		while (size <= fd)
+			size *= 2;
+		m->io_events = REALLOC(m->io_events, size * sizeof(thread_event_t));
+		memset(m->io_events + m->io_events_size, 0,
+		       (size - m->io_events_size) * sizeof(thread_event_t));
+		m->io_events_size = size;
+	}
+
+	return &m->io_events[fd];
+}
+
+/*
+ * Arm fd into the epoll set according to its pending read/write
+ * threads. Registrations are kept across wakeups and are oneshot, so
+ * a ready fd is disarmed by the kernel and only needs re-arming when
+ * a new thread is added. A persistent read thread is level triggered
+ * instead and stays armed. If the fd was closed and reopened in the
+ * meantime the kernel has already dropped it, so fall back to ADD.
+ */
+static void
+thread_epoll_arm(thread_master_t * m, int fd)
+{
+	thread_event_t *ev = &m->io_events[fd];
+	struct epoll_event event;
+
+#ifdef _WITH_SIMULATION_
+	/* Fds are fake, readiness comes from thread_sim_fd_ready() */
+	return;
+#endif
+
+	memset(&event, 0, sizeof(event));
+	event.events = (ev->read && ev->read->persistent) ? 0 : EPOLLONESHOT;
+	event.data.fd = fd;
+	if (ev->read)
+		event.events |= EPOLLIN;
+	if (ev->write)
+		event.events |= EPOLLOUT;
+
+	if (ev->registered) {
+		if (!epoll_ctl(m->epoll_fd, EPOLL_CTL_MOD, fd, &event))
+			return;
+		ev->registered = false;
+		if (errno != ENOENT && errno != EBADF)
+			log_message(LOG_INFO, "scheduler: epoll_ctl MOD fd %d error (%s)"
+					    , fd, strerror(errno));
+	}
+
+	if (!(event.events & (EPOLLIN | EPOLLOUT)))
+		return;
+
+	if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, fd, &event) &&
+	    (errno != EEXIST || epoll_ctl(m->epoll_fd, EPOLL_CTL_MOD, fd, &event))) {
+		log_message(LOG_INFO, "scheduler: epoll_ctl ADD fd %d error (%s)"
+				    , fd, strerror(errno));
+		return;
+	}
+	ev->registered = true;
+}
+
+/* Register a persistent level triggered read fd (signal, SNMP) */
+static void
+thread_epoll_add_persistent(thread_master_t * m, int fd)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, fd, &event) &&
+	    (errno != EEXIST || epoll_ctl(m->epoll_fd, EPOLL_CTL_MOD, fd, &event)))
+		log_message(LOG_INFO, "scheduler: epoll_ctl ADD fd %d error (%s)"
+				    , fd, strerror(errno));
+}
+
+#ifdef _WITH_SNMP_
+/* Keep the epoll set in sync with the SNMP agent fds */
+static void
+thread_epoll_snmp_sync(thread_master_t * m, fd_set *snmp_fds, int fdsetsize)
+{
+	thread_event_t *ev;
+	int fd, max_fd;
+
+	max_fd = (fdsetsize > m->snmp_fdsetsize) ? fdsetsize : m->snmp_fdsetsize;
+	for (fd = 0; fd < max_fd; fd++) {
+		if (!FD_ISSET(fd, snmp_fds) == !FD_ISSET(fd, &m->snmp_fds))
+			continue;
+
+		ev = thread_io_event(m, fd);
+		if (FD_ISSET(fd, snmp_fds)) {
+			ev->snmp = true;
+			thread_epoll_add_persistent(m, fd);
+		} else if (ev->snmp) {
+			ev->snmp = false;
+			epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+		}
+	}
+
+	m->snmp_fds = *snmp_fds;
+	m->snmp_fdsetsize = fdsetsize;
+}
+#endif
+
+/* Return the fd a thread waits on, a child waits on its pidfd */
+static inline int
+thread_io_fd(thread_t * thread)
+{
+	return thread->type == THREAD_CHILD ? thread->u.c.fd : thread->u.fd;
+}
+
+/* Register a fd thread into the epoll set */
+static bool
+thread_io_add(thread_master_t * m, thread_t * thread, bool write)
+{
+	int fd = thread_io_fd(thread);
+	thread_event_t *ev = thread_io_event(m, fd);
+
+	if (write ? ev->write != NULL : ev->read != NULL)
+		return false;
+
+	if (ev->snmp) {
+		/* The SNMP agent closed it, and the fd has been reused */
+		ev->snmp = false;
+		FD_CLR(fd, &m->snmp_fds);
+	}
+
+	if (write)
+		ev->write = thread;
+	else
+		ev->read = thread;
+	thread_epoll_arm(m, fd);
+
+	return true;
+}
+
+/* Unregister a fd thread from the epoll set */
+static void
+thread_io_del(thread_master_t * m, thread_t * thread)
+{
+	int fd = thread_io_fd(thread);
+	thread_event_t *ev = &m->io_events[fd];
+
+	if (ev->read == thread)
+		ev->read = NULL;
+	else if (ev->write == thread)
+		ev->write = NULL;
+	thread_epoll_arm(m, fd);
+}
+#endif
+
+/* Expiry time of a thread due in timer usecs from the cached time */
+static inline uint64_t
+thread_sands(long timer)
+{
+	return time_now_ns + (int64_t) timer * TIMER_NSEC_PER_USEC;
+}
+
 /* Make thread master. */
 thread_master_t *
 thread_make_master(void)
@@ -100,6 +306,14 @@ thread_make_master(void)
 	thread_master_t *new;
 
 	new = (thread_master_t *) MALLOC(sizeof (thread_master_t));
+	new->pool_max = THREAD_POOL_MAX;
+#ifdef _HAVE_EPOLL_
+	thread_io_init(new);
+#endif
+
+	/* Threads added before the first wakeup are timed from now */
+	set_time_now();
+
 	return new;
 }
 
@@ -117,35 +331,156 @@ thread_list_add(thread_list_t * list, thread_t * thread)
 	list->count++;
 }
 
-/* Add a new thread to the list. */
+/* Place a thread at heap position index */
+static inline void
+thread_heap_set(thread_heap_t * heap, unsigned int index, thread_t * thread)
+{
+	heap->nodes[index] = thread;
+	thread->heap_index = index;
+}
+
+/* Move a thread towards the root while it expires before its parent */
 static void
-thread_list_add_before(thread_list_t * list, thread_t * point, thread_t * thread)
+thread_heap_up(thread_heap_t * heap, unsigned int index)
 {
-	thread->next = point;
-	thread->prev = point->prev;
-	if (point->prev)
-		point->prev->next = thread;
+	thread_t *thread = heap->nodes[index];
+	unsigned int parent;
+
+	while (index) {
+		parent = (index - 1) / 2;
+		if (heap->nodes[parent]->sands <= thread->sands)
+			break;
+		thread_heap_set(heap, index, heap->nodes[parent]);
+		index = parent;
+	}
+	thread_heap_set(heap, index, thread);
+}
+
+/* Move a thread towards the leaves while a child expires before it */
+static void
+thread_heap_down(thread_heap_t * heap, unsigned int index)
+{
+	thread_t *thread = heap->nodes[index];
+	unsigned int child;
+
+	while ((child = 2 * index + 1) < heap->count) {
+		if (child + 1 < heap->count &&
+		    heap->nodes[child + 1]->sands < heap->nodes[child]->sands)
+			child++;
+		if (thread->sands <= heap->nodes[child]->sands)
+			break;
+		thread_heap_set(heap, index, heap->nodes[child]);
+		index = child;
+	}
+	thread_heap_set(heap, index, thread);
+}
+
+/* Add a thread to the heap ordered by timeval, O(log n) */
+static void
+thread_heap_add(thread_heap_t * heap, thread_t * thread)
+{
+	if (heap->count == heap->size) {
+		heap->size = heap->size ? heap->size * 2 : 64;
+		heap->nodes = REALLOC(heap->nodes, heap->size * sizeof(thread_t *));
+	}
+
+	heap->nodes[heap->count] = thread;
+	thread_heap_up(heap, heap->count++);
+}
+
+/* Delete a thread from the heap, O(log n) */
+static thread_t *
+thread_heap_delete(thread_heap_t * heap, thread_t * thread)
+{
+	unsigned int index = thread->heap_index;
+	thread_t *last;
+
+	assert(index < heap->count && heap->nodes[index] == thread);
+
+	last = heap->nodes[--heap->count];
+	if (last != thread) {
+		thread_heap_set(heap, index, last);
+		if (index && last->sands < heap->nodes[(index - 1) / 2]->sands)
+			thread_heap_up(heap, index);
+		else
+			thread_heap_down(heap, index);
+	}
+
+	return thread;
+}
+
+/* Move a thread whose sands changed to its new heap position, O(log n) */
+static void
+thread_heap_update(thread_heap_t * heap, thread_t * thread)
+{
+	unsigned int index = thread->heap_index;
+
+	assert(index < heap->count && heap->nodes[index] == thread);
+
+	if (index && thread->sands < heap->nodes[(index - 1) / 2]->sands)
+		thread_heap_up(heap, index);
 	else
-		list->head = thread;
-	point->prev = thread;
-	list->count++;
+		thread_heap_down(heap, index);
+}
+
+/* Return the thread expiring first, O(1) */
+static inline thread_t *
+thread_heap_min(thread_heap_t * heap)
+{
+	return heap->count ? heap->nodes[0] : NULL;
+}
+
+/* Return the first thread of the heap that has expired */
+static inline thread_t *
+thread_heap_expired(thread_heap_t * heap)
+{
+	if (heap->count && time_now_ns >= heap->nodes[0]->sands)
+		return heap->nodes[0];
+	return NULL;
 }
 
-/* Add a thread in the list sorted by timeval */
+/* Queue a child thread by timeout and index it by pid */
 static void
-thread_list_add_timeval(thread_list_t * list, thread_t * thread)
+thread_child_add(thread_master_t * m, thread_t * thread)
 {
-	thread_t *tt;
+	thread_t **bucket = &m->child_hash[thread->u.c.pid & (THREAD_CHILD_HASH_SIZE - 1)];
+
+	thread_heap_add(&m->child, thread);
+	thread->child_next = *bucket;
+	*bucket = thread;
+}
 
-	for (tt = list->head; tt; tt = tt->next) {
-		if (timer_cmp(thread->sands, tt->sands) <= 0)
+/* Remove a child thread from the timeout heap and pid hash */
+static void
+thread_child_delete(thread_master_t * m, thread_t * thread)
+{
+	thread_t **bucket = &m->child_hash[thread->u.c.pid & (THREAD_CHILD_HASH_SIZE - 1)];
+
+	thread_heap_delete(&m->child, thread);
+	for (; *bucket; bucket = &(*bucket)->child_next) {
+		if (*bucket == thread) {
+			*bucket = thread->child_next;
 			break;
+		}
 	}
+	thread->child_next = NULL;
 
-	if (tt)
-		thread_list_add_before(list, tt, thread);
-	else
-		thread_list_add(list, thread);
+#ifdef _HAVE_PIDFD_
+	if (thread->u.c.fd >= 0)
+		thread_io_del(m, thread);
+#endif
+}
+
+/* Find the child thread waiting for pid */
+static thread_t *
+thread_child_lookup(thread_master_t * m, pid_t pid)
+{
+	thread_t *thread = m->child_hash[pid & (THREAD_CHILD_HASH_SIZE - 1)];
+
+	while (thread && thread->u.c.pid != pid)
+		thread = thread->child_next;
+
+	return thread;
 }
 
 /* Delete a thread from the list. */
@@ -165,36 +500,71 @@ thread_list_delete(thread_list_t * list, thread_t * thread)
 	return thread;
 }
 
-/* Free all unused thread. */
+/* Release a slab chunk once none of its threads is in use */
 static void
-thread_clean_unuse(thread_master_t * m)
+thread_chunk_free(thread_master_t * m, thread_chunk_t * chunk)
 {
-	thread_t *thread;
+	void *mem = chunk->mem;
+	int i;
 
-	thread = m->unuse.head;
-	while (thread) {
-		thread_t *t;
+	for (i = 0; i < THREAD_CHUNK_SIZE; i++)
+		thread_list_delete(&m->unuse, &chunk->threads[i]);
 
-		t = thread;
-		thread = t->next;
+	if (chunk->next)
+		chunk->next->prev = chunk->prev;
+	if (chunk->prev)
+		chunk->prev->next = chunk->next;
+	else
+		m->chunks = chunk->next;
 
-		thread_list_delete(&m->unuse, t);
+	m->chunk_count--;
+	m->alloc -= THREAD_CHUNK_SIZE;
+	FREE(mem);
+}
 
-		/* free the thread */
-		FREE(t);
-		m->alloc--;
+/* Free all unused thread. */
+static void
+thread_clean_unuse(thread_master_t * m)
+{
+	thread_chunk_t *chunk;
+	void *mem;
+
+	/* Threads still referenced once the lists are destroyed are leaked
+	 * children, so the whole slab goes */
+	while ((chunk = m->chunks)) {
+		m->chunks = chunk->next;
+		mem = chunk->mem;
+		FREE(mem);
 	}
+
+	memset(&m->unuse, 0, sizeof(m->unuse));
+	m->chunk_count = 0;
+	m->alloc = 0;
 }
 
 /* Move thread to unuse list. */
 static void
 thread_add_unuse(thread_master_t * m, thread_t * thread)
 {
+	thread_chunk_t *chunk = thread->chunk;
+
 	assert(m != NULL);
 	assert(thread->next == NULL);
 	assert(thread->prev == NULL);
 	assert(thread->type == THREAD_UNUSED);
-	thread_list_add(&m->unuse, thread);
+
+	/* Most recently used first, so that idle chunks drain */
+	thread->prev = NULL;
+	thread->next = m->unuse.head;
+	if (m->unuse.head)
+		m->unuse.head->prev = thread;
+	else
+		m->unuse.tail = thread;
+	m->unuse.head = thread;
+	m->unuse.count++;
+
+	if (!--chunk->used && m->unuse.count > m->pool_max)
+		thread_chunk_free(m, chunk);
 }
 
 /* Move list element to unuse queue */
@@ -217,6 +587,8 @@ thread_destroy_list(thread_master_t * m, thread_list_t thread_list)
 		    t->type == THREAD_READ_TIMEOUT ||
 		    t->type == THREAD_WRITE_TIMEOUT)
 			close (t->u.fd);
+		else if (t->type == THREAD_CHILD_TIMEOUT && t->u.c.fd >= 0)
+			close (t->u.c.fd);
 
 		thread_list_delete(&thread_list, t);
 		t->type = THREAD_UNUSED;
@@ -224,17 +596,46 @@ thread_destroy_list(thread_master_t * m, thread_list_t thread_list)
 	}
 }
 
-/* Cleanup master */
-void
-thread_cleanup_master(thread_master_t * m)
+/* Move heap elements to unuse queue */
+static void
+thread_destroy_heap(thread_master_t * m, thread_heap_t * heap)
+{
+	thread_t *t;
+	unsigned int i;
+
+	for (i = 0; i < heap->count; i++) {
+		t = heap->nodes[i];
+
+		if (t->type == THREAD_READ ||
+		    t->type == THREAD_WRITE)
+			close (t->u.fd);
+		else if (t->type == THREAD_CHILD && t->u.c.fd >= 0)
+			close (t->u.c.fd);
+
+		t->type = THREAD_UNUSED;
+		thread_add_unuse(m, t);
+	}
+
+	FREE_PTR(heap->nodes);
+	heap->nodes = NULL;
+	heap->count = heap->size = 0;
+}
+
+/* Release all threads of the master */
+static void
+thread_destroy_threads(thread_master_t * m)
 {
+	int i;
+
 	/* Unuse current thread lists */
-	thread_destroy_list(m, m->read);
-	thread_destroy_list(m, m->write);
-	thread_destroy_list(m, m->timer);
-	thread_destroy_list(m, m->child);
+	thread_destroy_heap(m, &m->read);
+	thread_destroy_heap(m, &m->write);
+	thread_destroy_heap(m, &m->timer);
+	thread_destroy_heap(m, &m->child);
+	memset(m->child_hash, 0, sizeof(m->child_hash));
 	thread_destroy_list(m, m->event);
-	thread_destroy_list(m, m->ready);
+	for (i = 0; i < THREAD_PRIORITIES; i++)
+		thread_destroy_list(m, m->ready[i]);
 
 	/* Clear all FDs */
 	FD_ZERO(&m->readfd);
@@ -244,14 +645,38 @@ thread_cleanup_master(thread_master_t * m)
 	/* Clean garbage */
 	thread_clean_unuse(m);
 
+#ifdef _HAVE_EPOLL_
+	thread_io_release(m);
+#endif
+
+#ifdef _WITH_THREAD_STATS_
+	FREE_PTR(m->stats);
+	m->stats = NULL;
+	m->stats_count = m->stats_size = 0;
+#endif
+}
+
+/* Cleanup master */
+void
+thread_cleanup_master(thread_master_t * m)
+{
+	unsigned long pool_max = m->pool_max;
+
+	thread_destroy_threads(m);
+
 	memset(m, 0, sizeof(*m));
+	m->pool_max = pool_max;
+
+#ifdef _HAVE_EPOLL_
+	thread_io_init(m);
+#endif
 }
 
 /* Stop thread scheduler. */
 void
 thread_destroy_master(thread_master_t * m)
 {
-	thread_cleanup_master(m);
+	thread_destroy_threads(m);
 	FREE(m);
 }
 
@@ -264,57 +689,165 @@ thread_trim_head(thread_list_t * list)
 	return NULL;
 }
 
+/* Queue a thread for dispatch in its priority class */
+static void
+thread_ready_add(thread_master_t * m, thread_t * thread)
+{
+	thread_list_add(&m->ready[thread->priority], thread);
+}
+
+/* Take the next ready thread, highest priority class first */
+static thread_t *
+thread_trim_ready(thread_master_t * m)
+{
+	thread_t *thread;
+	int i;
+
+	for (i = THREAD_PRIORITIES - 1; i >= 0; i--) {
+		if ((thread = thread_trim_head(&m->ready[i])))
+			return thread;
+	}
+
+	return NULL;
+}
+
+/* Allocate a cache line aligned slab chunk and pool its threads */
+static void
+thread_chunk_new(thread_master_t * m)
+{
+	thread_chunk_t *chunk;
+	void *mem;
+	int i;
+
+	mem = MALLOC(sizeof(thread_chunk_t) + THREAD_CACHE_LINE - 1);
+	chunk = (thread_chunk_t *) (((unsigned long) mem + THREAD_CACHE_LINE - 1) &
+				    ~((unsigned long) THREAD_CACHE_LINE - 1));
+	chunk->mem = mem;
+
+	chunk->next = m->chunks;
+	if (m->chunks)
+		m->chunks->prev = chunk;
+	m->chunks = chunk;
+	m->chunk_count++;
+	m->alloc += THREAD_CHUNK_SIZE;
+
+	for (i = 0; i < THREAD_CHUNK_SIZE; i++) {
+		chunk->threads[i].chunk = chunk;
+		thread_list_add(&m->unuse, &chunk->threads[i]);
+	}
+}
+
 /* Make new thread. */
 static thread_t *
 thread_new(thread_master_t * m)
 {
 	thread_t *new;
+	thread_chunk_t *chunk;
 
-	/* If one thread is already allocated return it */
-	if (m->unuse.head) {
-		new = thread_trim_head(&m->unuse);
-		memset(new, 0, sizeof (thread_t));
-		return new;
-	}
+	if (!m->unuse.head)
+		thread_chunk_new(m);
 
-	new = (thread_t *) MALLOC(sizeof (thread_t));
-	m->alloc++;
+	new = thread_trim_head(&m->unuse);
+	chunk = new->chunk;
+	memset(new, 0, sizeof (thread_t));
+	new->chunk = chunk;
+	chunk->used++;
 	return new;
 }
 
-/* Add new read thread. */
-thread_t *
-thread_add_read(thread_master_t * m, int (*func) (thread_t *)
-		, void *arg, int fd, long timer)
+/* Set the high-water mark of the unused thread pool */
+void
+thread_set_pool_max(thread_master_t * m, unsigned long pool_max)
+{
+	m->pool_max = pool_max;
+}
+
+/* Report thread_t allocator usage */
+void
+thread_get_alloc_stats(thread_master_t * m, thread_alloc_stats_t * stats)
+{
+	stats->alloc = m->alloc;
+	stats->pooled = m->unuse.count;
+	stats->in_use = m->alloc - m->unuse.count;
+	stats->chunks = m->chunk_count;
+}
+
+/* Register a read thread, oneshot or persistent */
+static thread_t *
+thread_new_read(thread_master_t * m, int (*func) (thread_t *)
+		, void *arg, int fd, long timer, bool persistent)
 {
 	thread_t *thread;
 
 	assert(m != NULL);
 
+#ifndef _HAVE_EPOLL_
 	if (FD_ISSET(fd, &m->readfd)) {
 		log_message(LOG_WARNING, "There is already read fd [%d]", fd);
 		return NULL;
 	}
+#endif
 
 	thread = thread_new(m);
 	thread->type = THREAD_READ;
+	thread->persistent = persistent;
 	thread->id = 0;
 	thread->master = m;
 	thread->func = func;
 	thread->arg = arg;
-	FD_SET(fd, &m->readfd);
 	thread->u.fd = fd;
+#ifdef _HAVE_EPOLL_
+	if (!thread_io_add(m, thread, false)) {
+		log_message(LOG_WARNING, "There is already read fd [%d]", fd);
+		thread->type = THREAD_UNUSED;
+		thread_add_unuse(m, thread);
+		return NULL;
+	}
+#else
+	FD_SET(fd, &m->readfd);
+#endif
 
 	/* Compute read timeout value */
-	set_time_now();
-	thread->sands = timer_add_long(time_now, timer);
+	thread->sands = thread_sands(timer);
 
 	/* Sort the thread. */
-	thread_list_add_timeval(&m->read, thread);
+	thread_heap_add(&m->read, thread);
 
 	return thread;
 }
 
+/* Add new read thread. */
+thread_t *
+thread_add_read(thread_master_t * m, int (*func) (thread_t *)
+		, void *arg, int fd, long timer)
+{
+	return thread_new_read(m, func, arg, fd, timer, false);
+}
+
+/*
+ * Add a persistent read thread, for fds read for the process lifetime.
+ * It stays registered once dispatched, without a timeout until its
+ * handler sets the next one with thread_set_read_timer(). It is
+ * released by thread_cancel().
+ */
+thread_t *
+thread_add_read_persistent(thread_master_t * m, int (*func) (thread_t *)
+			   , void *arg, int fd, long timer)
+{
+	return thread_new_read(m, func, arg, fd, timer, true);
+}
+
+/* Move the timeout of a read thread waiting on its fd */
+void
+thread_set_read_timer(thread_t * thread, long timer)
+{
+	if (!thread || thread->type != THREAD_READ)
+		return;
+
+	thread->sands = thread_sands(timer);
+	thread_heap_update(&thread->master->read, thread);
+}
+
 /* Add new write thread. */
 thread_t *
 thread_add_write(thread_master_t * m, int (*func) (thread_t *)
@@ -324,10 +857,12 @@ thread_add_write(thread_master_t * m, int (*func) (thread_t *)
 
 	assert(m != NULL);
 
+#ifndef _HAVE_EPOLL_
 	if (FD_ISSET(fd, &m->writefd)) {
 		log_message(LOG_WARNING, "There is already write fd [%d]", fd);
 		return NULL;
 	}
+#endif
 
 	thread = thread_new(m);
 	thread->type = THREAD_WRITE;
@@ -335,15 +870,23 @@ thread_add_write(thread_master_t * m, int (*func) (thread_t *)
 	thread->master = m;
 	thread->func = func;
 	thread->arg = arg;
-	FD_SET(fd, &m->writefd);
 	thread->u.fd = fd;
+#ifdef _HAVE_EPOLL_
+	if (!thread_io_add(m, thread, true)) {
+		log_message(LOG_WARNING, "There is already write fd [%d]", fd);
+		thread->type = THREAD_UNUSED;
+		thread_add_unuse(m, thread);
+		return NULL;
+	}
+#else
+	FD_SET(fd, &m->writefd);
+#endif
 
 	/* Compute write timeout value */
-	set_time_now();
-	thread->sands = timer_add_long(time_now, timer);
+	thread->sands = thread_sands(timer);
 
 	/* Sort the thread. */
-	thread_list_add_timeval(&m->write, thread);
+	thread_heap_add(&m->write, thread);
 
 	return thread;
 }
@@ -365,11 +908,10 @@ thread_add_timer(thread_master_t * m, int (*func) (thread_t *)
 	thread->arg = arg;
 
 	/* Do we need jitter here? */
-	set_time_now();
-	thread->sands = timer_add_long(time_now, timer);
+	thread->sands = thread_sands(timer);
 
 	/* Sort by timeval. */
-	thread_list_add_timeval(&m->timer, thread);
+	thread_heap_add(&m->timer, thread);
 
 	return thread;
 }
@@ -391,17 +933,43 @@ thread_add_child(thread_master_t * m, int (*func) (thread_t *)
 	thread->arg = arg;
 	thread->u.c.pid = pid;
 	thread->u.c.status = 0;
+	thread->u.c.fd = -1;
+
+#ifdef _HAVE_PIDFD_
+	/* Wait on the child's pidfd, reusing it if the child was just
+	 * timed out, since its pid may no longer be ours to open */
+	if (pid == m->timeout_pid && m->timeout_pidfd >= 0) {
+		thread->u.c.fd = m->timeout_pidfd;
+		m->timeout_pidfd = -1;
+	} else
+		thread->u.c.fd = syscall(SYS_pidfd_open, pid, 0);
+	if (thread->u.c.fd >= 0 && !thread_io_add(m, thread, false)) {
+		close(thread->u.c.fd);
+		thread->u.c.fd = -1;
+	}
+#endif
 
 	/* Compute write timeout value */
-	set_time_now();
-	thread->sands = timer_add_long(time_now, timer);
+	thread->sands = thread_sands(timer);
 
 	/* Sort by timeval. */
-	thread_list_add_timeval(&m->child, thread);
+	thread_child_add(m, thread);
 
 	return thread;
 }
 
+/* Signal the process of a child thread. With a pidfd this cannot hit
+ * another process that reused the pid after the child was reaped. */
+int
+thread_child_kill(thread_t * thread, int sig)
+{
+#ifdef _HAVE_PIDFD_
+	if (thread->u.c.fd >= 0)
+		return syscall(SYS_pidfd_send_signal, thread->u.c.fd, sig, NULL, 0);
+#endif
+	return kill(thread->u.c.pid, sig);
+}
+
 /* Add simple event thread. */
 thread_t *
 thread_add_event(thread_master_t * m, int (*func) (thread_t *)
@@ -452,31 +1020,52 @@ thread_cancel(thread_t * thread)
 
 	switch (thread->type) {
 	case THREAD_READ:
+#ifdef _HAVE_EPOLL_
+		thread_io_del(thread->master, thread);
+#else
 		assert(FD_ISSET(thread->u.fd, &thread->master->readfd));
 		FD_CLR(thread->u.fd, &thread->master->readfd);
-		thread_list_delete(&thread->master->read, thread);
+#endif
+		thread_heap_delete(&thread->master->read, thread);
 		break;
 	case THREAD_WRITE:
+#ifdef _HAVE_EPOLL_
+		thread_io_del(thread->master, thread);
+#else
 		assert(FD_ISSET(thread->u.fd, &thread->master->writefd));
 		FD_CLR(thread->u.fd, &thread->master->writefd);
-		thread_list_delete(&thread->master->write, thread);
+#endif
+		thread_heap_delete(&thread->master->write, thread);
 		break;
 	case THREAD_TIMER:
-		thread_list_delete(&thread->master->timer, thread);
+		thread_heap_delete(&thread->master->timer, thread);
 		break;
 	case THREAD_CHILD:
 		/* Does this need to kill the child, or is that the
 		 * caller's job?
 		 * This function is currently unused, so leave it for now.
 		 */
-		thread_list_delete(&thread->master->child, thread);
+		thread_child_delete(thread->master, thread);
+		if (thread->u.c.fd >= 0)
+			close(thread->u.c.fd);
 		break;
 	case THREAD_EVENT:
 		thread_list_delete(&thread->master->event, thread);
 		break;
-	case THREAD_READY:
 	case THREAD_READY_FD:
-		thread_list_delete(&thread->master->ready, thread);
+	case THREAD_READ_TIMEOUT:
+		thread_list_delete(&thread->master->ready[thread->priority], thread);
+		if (thread->persistent) {
+			/* Still registered on its fd */
+#ifdef _HAVE_EPOLL_
+			thread_io_del(thread->master, thread);
+#else
+			FD_CLR(thread->u.fd, &thread->master->readfd);
+#endif
+		}
+		break;
+	case THREAD_READY:
+		thread_list_delete(&thread->master->ready[thread->priority], thread);
 		break;
 	default:
 		break;
@@ -487,6 +1076,25 @@ thread_cancel(thread_t * thread)
 	return 0;
 }
 
+/* Usecs left before a thread times out, negative once expired */
+long
+thread_time_to_wakeup(thread_t * thread)
+{
+	return (int64_t) (thread->sands - time_now_ns) / TIMER_NSEC_PER_USEC;
+}
+
+/* Set the dispatch class of a thread, before it becomes ready */
+void
+thread_set_priority(thread_t * thread, unsigned char priority)
+{
+	if (!thread)
+		return;
+
+	assert(priority < THREAD_PRIORITIES);
+
+	thread->priority = priority;
+}
+
 #ifdef _INCLUDE_UNUSED_CODE_
 /* Delete all events which has argument value arg. */
 void
@@ -512,49 +1120,240 @@ thread_cancel_event(thread_master_t * m, void *arg)
 
 /* Update timer value */
 static void
-thread_update_timer(thread_list_t *list, timeval_t *timer_min)
+thread_update_timer(thread_heap_t *heap, uint64_t *timer_min)
 {
-	if (list->head) {
-		if (!timer_isnull(*timer_min)) {
-			if (timer_cmp(list->head->sands, *timer_min) <= 0) {
-				*timer_min = list->head->sands;
-			}
-		} else {
-			*timer_min = list->head->sands;
-		}
-	}
+	thread_t *thread = thread_heap_min(heap);
+
+	if (thread && thread->sands < *timer_min)
+		*timer_min = thread->sands;
 }
 
 /* Compute the wait timer. Take care of timeouted fd */
 static void
 thread_compute_timer(thread_master_t * m, timeval_t * timer_wait)
 {
-	timeval_t timer_min;
+	uint64_t timer_min;
 
-	/* Prepare timer */
-	timer_reset(timer_min);
+	/* Wait at most 1 second */
+	timer_min = time_now_ns + TIMER_NSEC_PER_SEC;
 	thread_update_timer(&m->timer, &timer_min);
 	thread_update_timer(&m->write, &timer_min);
 	thread_update_timer(&m->read, &timer_min);
 	thread_update_timer(&m->child, &timer_min);
 
-	/* Take care about monotonic clock */
-	if (!timer_isnull(timer_min)) {
-		timer_min = timer_sub(timer_min, time_now);
-		if (timer_min.tv_sec < 0) {
-			timer_min.tv_sec = timer_min.tv_usec = 0;
-		} else if (timer_min.tv_sec >= 1) {
-			timer_min.tv_sec = 1;
-			timer_min.tv_usec = 0;
+	if (timer_min < time_now_ns)
+		timer_min = time_now_ns;
+	*timer_wait = timer_from_ns(timer_min - time_now_ns);
+}
+
+/* Queue the handler of a reaped child */
+static void
+thread_child_reaped(thread_master_t * m, thread_t * thread, int status, bool respawn)
+{
+	thread_child_delete(m, thread);
+	if (thread->u.c.fd >= 0) {
+		close(thread->u.c.fd);
+		thread->u.c.fd = -1;
+	}
+	thread->u.c.status = status;
+	if (respawn) {
+		thread->type = THREAD_READY;
+		thread_ready_add(m, thread);
+	}
+	else {
+		/* The child had a permanant error, so no point in respawning */
+		raise(SIGTERM);
+	}
+}
+
+#ifdef _HAVE_EPOLL_
+#ifdef _HAVE_PIDFD_
+/* The pidfd of a child became readable, reap that child only */
+static void
+thread_child_exited(thread_master_t * m, thread_t * thread)
+{
+	pid_t pid;
+	int status;
+
+	pid = waitpid(thread->u.c.pid, &status, WNOHANG);
+	if (pid == thread->u.c.pid) {
+		thread_child_reaped(m, thread, status, !report_child_status(status, pid, NULL));
+		return;
+	}
+
+	/* Not reaped here, wait for the child to exit or time out */
+	if (!pid)
+		thread_io_add(m, thread, false);
+}
+#endif
+
+/* Move the fd threads reported ready by epoll_wait() to the ready queue */
+static void
+thread_epoll_ready(thread_master_t * m, int count, fd_set *snmp_readfd, bool *signal_ready)
+{
+	struct epoll_event *event;
+	thread_event_t *ev;
+	thread_t *t;
+	bool rearm;
+	int i, fd;
+
+	for (i = 0; i < count; i++) {
+		event = &m->epoll_events[i];
+		fd = event->data.fd;
+
+		if (fd == m->signal_fd) {
+			*signal_ready = true;
+			continue;
 		}
 
-		timer_wait->tv_sec = timer_min.tv_sec;
-		timer_wait->tv_usec = timer_min.tv_usec;
-	} else {
-		timer_wait->tv_sec = 1;
-		timer_wait->tv_usec = 0;
+		if (fd >= m->io_events_size)
+			continue;
+		ev = &m->io_events[fd];
+
+		if (ev->snmp) {
+			if (snmp_readfd)
+				FD_SET(fd, snmp_readfd);
+			continue;
+		}
+
+		/* A oneshot registration is now disarmed, a persistent one stays armed */
+		rearm = !(ev->read && ev->read->persistent);
+
+		/* Like select(), report hangup and error as readiness */
+		if ((event->events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && ev->read) {
+			t = ev->read;
+			if (!t->persistent)
+				ev->read = NULL;
+#ifdef _HAVE_PIDFD_
+			if (t->type == THREAD_CHILD) {
+				thread_child_exited(m, t);
+				continue;
+			}
+#endif
+			/* A persistent thread may not have been dispatched yet */
+			if (t->type == THREAD_READ) {
+				thread_heap_delete(&m->read, t);
+				thread_ready_add(m, t);
+				t->type = THREAD_READY_FD;
+			}
+		}
+
+		if ((event->events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) && ev->write) {
+			t = ev->write;
+			ev->write = NULL;
+			thread_heap_delete(&m->write, t);
+			thread_ready_add(m, t);
+			t->type = THREAD_READY_FD;
+			rearm = true;
+		}
+
+		if (rearm && (ev->read || ev->write))
+			thread_epoll_arm(m, fd);
 	}
 }
+#endif
+
+#ifdef _WITH_SIMULATION_
+/* Report an fd ready as the kernel would. Returns 0 if a thread waited on it */
+int
+thread_sim_fd_ready(thread_master_t * m, int fd, bool write)
+{
+	thread_heap_t *heap = write ? &m->write : &m->read;
+	thread_t *t = NULL;
+#ifdef _HAVE_EPOLL_
+	thread_event_t *ev;
+
+	if (fd < 0 || fd >= m->io_events_size)
+		return -1;
+	ev = &m->io_events[fd];
+	t = write ? ev->write : ev->read;
+	if (!t || t->type != (write ? THREAD_WRITE : THREAD_READ))
+		return -1;
+	if (write)
+		ev->write = NULL;
+	else if (!t->persistent)
+		ev->read = NULL;
+#else
+	unsigned int i;
+
+	for (i = 0; i < heap->count && !t; i++)
+		if (heap->nodes[i]->u.fd == fd)
+			t = heap->nodes[i];
+	if (!t)
+		return -1;
+	if (!t->persistent)
+		FD_CLR(fd, write ? &m->writefd : &m->readfd);
+#endif
+
+	thread_heap_delete(heap, t);
+	thread_ready_add(m, t);
+	t->type = THREAD_READY_FD;
+	return 0;
+}
+#endif
+
+#ifndef _HAVE_EPOLL_
+/* Move the fd threads that are ready or have timed out to the ready queue */
+static void
+thread_select_ready(thread_master_t * m, thread_heap_t * heap, fd_set *master_fds,
+		    fd_set *ready_fds, unsigned char timeout_type)
+{
+	thread_t *t, *ready = NULL;
+	unsigned int i;
+
+	/* Collect first, the heap is reordered by deletions */
+	for (i = 0; i < heap->count; i++) {
+		t = heap->nodes[i];
+
+		if (FD_ISSET(t->u.fd, ready_fds)) {
+			assert(FD_ISSET(t->u.fd, master_fds));
+			t->type = THREAD_READY_FD;
+		} else if (time_now_ns >= t->sands)
+			t->type = timeout_type;
+		else
+			continue;
+
+		t->next = ready;
+		ready = t;
+	}
+
+	while ((t = ready)) {
+		ready = t->next;
+		t->next = NULL;
+		if (!t->persistent)
+			FD_CLR(t->u.fd, master_fds);
+		thread_heap_delete(heap, t);
+		thread_ready_add(m, t);
+	}
+}
+#endif
+
+/* Hand a ready thread over to the caller */
+static thread_t *
+thread_fetch_ready(thread_master_t * m, thread_t * thread, thread_t * fetch)
+{
+	*fetch = *thread;
+
+	/* A persistent read thread waits for its fd again, the handler sets its timeout */
+	if (thread->persistent) {
+		thread->sands = UINT64_MAX;
+		thread->type = THREAD_READ;
+		thread_heap_add(&m->read, thread);
+		return fetch;
+	}
+
+#ifdef _HAVE_PIDFD_
+	/* A timed out child keeps its pidfd while its handler runs */
+	if (thread->type == THREAD_CHILD_TIMEOUT && thread->u.c.fd >= 0) {
+		m->timeout_pid = thread->u.c.pid;
+		m->timeout_pidfd = thread->u.c.fd;
+	}
+#endif
+
+	thread->type = THREAD_UNUSED;
+	thread_add_unuse(m, thread);
+	return fetch;
+}
 
 /* Fetch next ready thread. */
 thread_t *
@@ -562,24 +1361,45 @@ thread_fetch(thread_master_t * m, thread_t * fetch)
 {
 	int ret, old_errno;
 	thread_t *thread;
+#ifdef _HAVE_EPOLL_
+	bool signal_ready;
+	long timeout_ms;
+#else
 	fd_set readfd;
 	fd_set writefd;
 	fd_set exceptfd;
+#endif
 	timeval_t timer_wait;
 	int signal_fd;
 #ifdef _WITH_SNMP_
 	timeval_t snmp_timer_wait;
 	int snmpblock = 0;
 	int fdsetsize;
+#ifdef _HAVE_EPOLL_
+	fd_set snmp_fds;
+	fd_set readfd;
+#endif
 #endif
 
 	assert(m != NULL);
 
+#ifdef _HAVE_PIDFD_
+	/* The handler of the last timed out child has run */
+	if (m->timeout_pidfd >= 0) {
+		close(m->timeout_pidfd);
+		m->timeout_pidfd = -1;
+	}
+#endif
+
 	/* Timer initialization */
 	memset(&timer_wait, 0, sizeof (timeval_t));
 
 retry:	/* When thread can't fetch try to find next thread again. */
 
+	/* Failover critical threads run ahead of queued events */
+	if ((thread = thread_trim_head(&m->ready[THREAD_PRIORITY_HIGH])))
+		return thread_fetch_ready(m, thread, fetch);
+
 	/* If there is event process it first. */
 	while ((thread = thread_trim_head(&m->event))) {
 		*fetch = *thread;
@@ -595,13 +1415,9 @@ retry:	/* When thread can't fetch try to find next thread again. */
 		return fetch;
 	}
 
-	/* If there is ready threads process them */
-	while ((thread = thread_trim_head(&m->ready))) {
-		*fetch = *thread;
-		thread->type = THREAD_UNUSED;
-		thread_add_unuse(m, thread);
-		return fetch;
-	}
+	/* If there is ready threads process them, highest class first */
+	if ((thread = thread_trim_ready(m)))
+		return thread_fetch_ready(m, thread, fetch);
 
 	/*
 	 * Re-read the current time to get the maximum accuracy.
@@ -610,12 +1426,70 @@ retry:	/* When thread can't fetch try to find next thread again. */
 	set_time_now();
 	thread_compute_timer(m, &timer_wait);
 
+	signal_fd = signal_rfd();
+
+#ifdef _HAVE_EPOLL_
+	/* The signal fd stays registered for the master lifetime */
+	if (signal_fd != m->signal_fd) {
+		m->signal_fd = signal_fd;
+		if (signal_fd >= 0)
+			thread_epoll_add_persistent(m, signal_fd);
+	}
+
+#ifdef _WITH_SNMP_
+	/* The SNMP agent publishes its fds through an fd_set, see below */
+	fdsetsize = 0;
+	snmpblock = 0;
+	FD_ZERO(&snmp_fds);
+	memcpy(&snmp_timer_wait, &timer_wait, sizeof(timeval_t));
+	snmp_select_info(&fdsetsize, &snmp_fds, &snmp_timer_wait, &snmpblock);
+	if (snmpblock == 0)
+		memcpy(&timer_wait, &snmp_timer_wait, sizeof(timeval_t));
+	thread_epoll_snmp_sync(m, &snmp_fds, fdsetsize);
+	FD_ZERO(&readfd);
+#endif
+
+	/* Round up so that we never wake up before the next timer */
+	timeout_ms = (timer_long(timer_wait) + 999) / 1000;
+#ifdef _WITH_SIMULATION_
+	/* Nothing is runnable: jump to the next timer instead of sleeping */
+	(void) timeout_ms;
+	timer_sim_advance(timer_ns(timer_wait));
+	ret = 0;
+	old_errno = 0;
+#else
+	ret = epoll_wait(m->epoll_fd, m->epoll_events, THREAD_EPOLL_EVENTS, timeout_ms);
+
+	/* we have to save errno here because the next syscalls will set it */
+	old_errno = errno;
+#endif
+
+	signal_ready = false;
+	if (ret > 0) {
+#ifdef _WITH_SNMP_
+		thread_epoll_ready(m, ret, &readfd, &signal_ready);
+#else
+		thread_epoll_ready(m, ret, NULL, &signal_ready);
+#endif
+	}
+
+	/* Handle SNMP stuff */
+#ifdef _WITH_SNMP_
+	if (ret > 0)
+		snmp_read(&readfd);
+	else if (ret == 0)
+		snmp_timeout();
+#endif
+
+	/* handle signals synchronously, including child reaping */
+	if (signal_ready)
+		signal_run_callback();
+#else
 	/* Call select function. */
 	readfd = m->readfd;
 	writefd = m->writefd;
 	exceptfd = m->exceptfd;
 
-	signal_fd = signal_rfd();
 	FD_SET(signal_fd, &readfd);
 
 #ifdef _WITH_SNMP_
@@ -632,10 +1506,20 @@ retry:	/* When thread can't fetch try to find next thread again. */
 		memcpy(&timer_wait, &snmp_timer_wait, sizeof(timeval_t));
 #endif
 
+#ifdef _WITH_SIMULATION_
+	/* Nothing is runnable: jump to the next timer instead of sleeping */
+	timer_sim_advance(timer_ns(timer_wait));
+	FD_ZERO(&readfd);
+	FD_ZERO(&writefd);
+	FD_ZERO(&exceptfd);
+	ret = 0;
+	old_errno = 0;
+#else
 	ret = select(FD_SETSIZE, &readfd, &writefd, &exceptfd, &timer_wait);
 
 	/* we have to save errno here because the next syscalls will set it */
 	old_errno = errno;
+#endif
 
        /* Handle SNMP stuff */
 #ifdef _WITH_SNMP_
@@ -648,6 +1532,7 @@ retry:	/* When thread can't fetch try to find next thread again. */
 	/* handle signals synchronously, including child reaping */
 	if (FD_ISSET(signal_fd, &readfd))
 		signal_run_callback();
+#endif
 
 	/* Update current time */
 	set_time_now();
@@ -661,89 +1546,48 @@ retry:	/* When thread can't fetch try to find next thread again. */
 	}
 
 	/* Timeout children */
-	thread = m->child.head;
-	while (thread) {
-		thread_t *t;
-
-		t = thread;
-		thread = t->next;
-
-		if (timer_cmp(time_now, t->sands) >= 0) {
-			thread_list_delete(&m->child, t);
-			thread_list_add(&m->ready, t);
-			t->type = THREAD_CHILD_TIMEOUT;
-		} else
-			break;
+	while ((thread = thread_heap_expired(&m->child))) {
+		thread_child_delete(m, thread);
+		thread_ready_add(m, thread);
+		thread->type = THREAD_CHILD_TIMEOUT;
 	}
 
-	/* Read thead. */
-	thread = m->read.head;
-	while (thread) {
-		thread_t *t;
-
-		t = thread;
-		thread = t->next;
+#ifdef _HAVE_EPOLL_
+	/* Ready fds are already queued, only timeouts are left */
+	while ((thread = thread_heap_expired(&m->read))) {
+		thread_heap_delete(&m->read, thread);
+		if (!thread->persistent)
+			thread_io_del(m, thread);
+		thread_ready_add(m, thread);
+		thread->type = THREAD_READ_TIMEOUT;
+	}
 
-		if (FD_ISSET(t->u.fd, &readfd)) {
-			assert(FD_ISSET(t->u.fd, &m->readfd));
-			FD_CLR(t->u.fd, &m->readfd);
-			thread_list_delete(&m->read, t);
-			thread_list_add(&m->ready, t);
-			t->type = THREAD_READY_FD;
-		} else {
-			if (timer_cmp(time_now, t->sands) >= 0) {
-				FD_CLR(t->u.fd, &m->readfd);
-				thread_list_delete(&m->read, t);
-				thread_list_add(&m->ready, t);
-				t->type = THREAD_READ_TIMEOUT;
-			}
-		}
+	while ((thread = thread_heap_expired(&m->write))) {
+		thread_heap_delete(&m->write, thread);
+		thread_io_del(m, thread);
+		thread_ready_add(m, thread);
+		thread->type = THREAD_WRITE_TIMEOUT;
 	}
+#else
+	/* Read thead. */
+	thread_select_ready(m, &m->read, &m->readfd, &readfd, THREAD_READ_TIMEOUT);
 
 	/* Write thead. */
-	thread = m->write.head;
-	while (thread) {
-		thread_t *t;
+	thread_select_ready(m, &m->write, &m->writefd, &writefd, THREAD_WRITE_TIMEOUT);
 
-		t = thread;
-		thread = t->next;
-
-		if (FD_ISSET(t->u.fd, &writefd)) {
-			assert(FD_ISSET(t->u.fd, &writefd));
-			FD_CLR(t->u.fd, &m->writefd);
-			thread_list_delete(&m->write, t);
-			thread_list_add(&m->ready, t);
-			t->type = THREAD_READY_FD;
-		} else {
-			if (timer_cmp(time_now, t->sands) >= 0) {
-				FD_CLR(t->u.fd, &m->writefd);
-				thread_list_delete(&m->write, t);
-				thread_list_add(&m->ready, t);
-				t->type = THREAD_WRITE_TIMEOUT;
-			}
-		}
-	}
 	/* Exception thead. */
 	/*... */
+#endif
 
 	/* Timer update. */
-	thread = m->timer.head;
-	while (thread) {
-		thread_t *t;
-
-		t = thread;
-		thread = t->next;
-
-		if (timer_cmp(time_now, t->sands) >= 0) {
-			thread_list_delete(&m->timer, t);
-			thread_list_add(&m->ready, t);
-			t->type = THREAD_READY;
-		} else
-			break;
+	while ((thread = thread_heap_expired(&m->timer))) {
+		thread_heap_delete(&m->timer, thread);
+		thread_ready_add(m, thread);
+		thread->type = THREAD_READY;
 	}
 
 	/* Return one event. */
-	thread = thread_trim_head(&m->ready);
+	thread = thread_trim_ready(m);
 
 #ifdef _WITH_SNMP_
 	run_alarms();
@@ -754,11 +1598,7 @@ retry:	/* When thread can't fetch try to find next thread again. */
 	if (!thread)
 		goto retry;
 
-	*fetch = *thread;
-	thread->type = THREAD_UNUSED;
-	thread_add_unuse(m, thread);
-
-	return fetch;
+	return thread_fetch_ready(m, thread, fetch);
 }
 
 /* Synchronous signal handler to reap child processes */
@@ -766,12 +1606,7 @@ static void
 thread_child_handler(void * v, int sig)
 {
 	thread_master_t * m = v;
-
-	/*
-	 * This is O(n^2), but there will only be a few entries on
-	 * this list.
-	 */
-	thread_t *thread;
+	thread_t *t;
 	pid_t pid;
 	int status;
 	bool respawn;
@@ -785,26 +1620,9 @@ thread_child_handler(void * v, int sig)
 		} else {
 			respawn = !report_child_status(status, pid, NULL);
 
-			thread = m->child.head;
-			while (thread) {
-				thread_t *t;
-				t = thread;
-				thread = t->next;
-				if (pid == t->u.c.pid) {
-					thread_list_delete(&m->child, t);
-					t->u.c.status = status;
-					if (respawn) {
-						t->type = THREAD_READY;
-						thread_list_add(&m->ready, t);
-					}
-					else {
-						/* The child had a permanant error, so no point in respawning */
-						raise(SIGTERM);
-					}
-
-					break;
-				}
-			}
+			t = thread_child_lookup(m, pid);
+			if (t)
+				thread_child_reaped(m, t, status, respawn);
 		}
 	}
 }
@@ -818,12 +1636,221 @@ thread_get_id(void)
 	return ++counter;
 }
 
+#ifdef _WITH_THREAD_STATS_
+/* Histogram bucket of a duration: <1us, <2us, <4us, ... */
+static unsigned int
+thread_stats_bucket(uint64_t ns)
+{
+	uint64_t usec = ns / TIMER_NSEC_PER_USEC;
+	unsigned int bucket;
+
+	if (!usec)
+		return 0;
+	bucket = 64 - __builtin_clzll(usec);
+	return bucket < THREAD_STATS_BUCKETS ? bucket : THREAD_STATS_BUCKETS - 1;
+}
+
+static unsigned int
+thread_stats_hash(int (*func) (thread_t *), unsigned char type, unsigned int size)
+{
+	uintptr_t key = (uintptr_t) func;
+
+	key ^= key >> 7;
+	key = key * 31 + type;
+	return (unsigned int) key & (size - 1);
+}
+
+/* Lookup the statistics slot of a handler, creating it if needed */
+static thread_stats_t *
+thread_stats_get(thread_master_t * m, int (*func) (thread_t *), unsigned char type)
+{
+	thread_stats_t *old, *stats;
+	unsigned int i, h, old_size;
+
+	/* Keep the table at most half full */
+	if (2 * (m->stats_count + 1) > m->stats_size) {
+		old = m->stats;
+		old_size = m->stats_size;
+		m->stats_size = old_size ? old_size * 2 : 64;
+		m->stats = (thread_stats_t *) MALLOC(m->stats_size * sizeof(thread_stats_t));
+		for (i = 0; i < old_size; i++) {
+			if (!old[i].func)
+				continue;
+			h = thread_stats_hash(old[i].func, old[i].type, m->stats_size);
+			while (m->stats[h].func)
+				h = (h + 1) & (m->stats_size - 1);
+			m->stats[h] = old[i];
+		}
+		FREE_PTR(old);
+	}
+
+	h = thread_stats_hash(func, type, m->stats_size);
+	for (stats = &m->stats[h]; stats->func; stats = &m->stats[h]) {
+		if (stats->func == func && stats->type == type)
+			return stats;
+		h = (h + 1) & (m->stats_size - 1);
+	}
+
+	stats->func = func;
+	stats->type = type;
+	m->stats_count++;
+	return stats;
+}
+
+/* Account a handler run, from start to end */
+static void
+thread_stats_update(thread_t * thread, uint64_t start, uint64_t end)
+{
+	thread_master_t *m = thread->master;
+	thread_stats_t *stats;
+	uint64_t run = end - start, lag;
+
+	if (!m)
+		return;
+
+	stats = thread_stats_get(m, thread->func, thread->type);
+	stats->calls++;
+	stats->run_ns += run;
+	if (run > stats->run_max_ns)
+		stats->run_max_ns = run;
+	stats->run_hist[thread_stats_bucket(run)]++;
+
+	/* Loop lag: how late an expired timer got to run */
+	if (thread->type != THREAD_READY &&
+	    thread->type != THREAD_READ_TIMEOUT &&
+	    thread->type != THREAD_WRITE_TIMEOUT &&
+	    thread->type != THREAD_CHILD_TIMEOUT)
+		return;
+	if (!thread->sands || thread->sands > start)
+		return;
+
+	lag = start - thread->sands;
+	stats->lag_calls++;
+	stats->lag_ns += lag;
+	if (lag > stats->lag_max_ns)
+		stats->lag_max_ns = lag;
+	m->lag_hist[thread_stats_bucket(lag)]++;
+}
+
+static const char *
+thread_type_str(unsigned char type)
+{
+	static const char *types[] = {
+		"READ", "WRITE", "TIMER", "EVENT", "CHILD", "READY", "UNUSED",
+		"WRITE_TIMEOUT", "READ_TIMEOUT", "CHILD_TIMEOUT", "TERMINATE",
+		"READY_FD"
+	};
+
+	if (type < sizeof(types) / sizeof(types[0]))
+		return types[type];
+	return "UNKNOWN";
+}
+
+static void
+thread_stats_print(FILE * fp, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	if (fp) {
+		vfprintf(fp, fmt, args);
+		fputc('\n', fp);
+	} else
+		vlog_message(LOG_INFO, fmt, args);
+	va_end(args);
+}
+
+static void
+thread_stats_print_hist(FILE * fp, const char *name, unsigned long *hist)
+{
+	char buf[512];
+	int len = 0, i;
+
+	for (i = 0; i < THREAD_STATS_BUCKETS && len < (int) sizeof(buf); i++) {
+		if (!hist[i])
+			continue;
+		if (i == THREAD_STATS_BUCKETS - 1)
+			len += snprintf(buf + len, sizeof(buf) - len, " >=%luus:%lu"
+					, 1UL << (i - 1), hist[i]);
+		else
+			len += snprintf(buf + len, sizeof(buf) - len, " <%luus:%lu"
+					, 1UL << i, hist[i]);
+	}
+	if (len)
+		thread_stats_print(fp, "%s%s", name, buf);
+}
+
+static int
+thread_stats_cmp(const void *a, const void *b)
+{
+	const thread_stats_t *sa = *(const thread_stats_t * const *) a;
+	const thread_stats_t *sb = *(const thread_stats_t * const *) b;
+
+	if (sa->run_ns == sb->run_ns)
+		return 0;
+	return sa->run_ns < sb->run_ns ? 1 : -1;
+}
+
+/*
+ * Dump the handler statistics, the most expensive handlers first. Handler
+ * functions are reported with their offset into the executable, to be
+ * resolved with addr2line. Writes to fp, or logs when fp is NULL.
+ */
+void
+thread_dump_stats(thread_master_t * m, FILE * fp)
+{
+	extern char __executable_start;
+	thread_stats_t **sorted, *stats;
+	unsigned int i, n = 0;
+
+	thread_stats_print(fp, "Scheduler handlers: %u", m->stats_count);
+	thread_stats_print_hist(fp, "  Timer lag histogram:", m->lag_hist);
+	if (!m->stats_count)
+		return;
+
+	sorted = (thread_stats_t **) MALLOC(m->stats_count * sizeof(thread_stats_t *));
+	for (i = 0; i < m->stats_size; i++)
+		if (m->stats[i].func)
+			sorted[n++] = &m->stats[i];
+	qsort(sorted, n, sizeof(thread_stats_t *), thread_stats_cmp);
+
+	for (i = 0; i < n; i++) {
+		stats = sorted[i];
+		thread_stats_print(fp, "  Handler %p (+0x%lx) %s: calls %lu, run total %" PRIu64
+				   "us, avg %" PRIu64 "us, max %" PRIu64 "us"
+				   , stats->func
+				   , (unsigned long) ((char *) stats->func - &__executable_start)
+				   , thread_type_str(stats->type), stats->calls
+				   , stats->run_ns / TIMER_NSEC_PER_USEC
+				   , stats->run_ns / stats->calls / TIMER_NSEC_PER_USEC
+				   , stats->run_max_ns / TIMER_NSEC_PER_USEC);
+		if (stats->lag_calls)
+			thread_stats_print(fp, "    Lag avg %" PRIu64 "us, max %" PRIu64 "us"
+					   , stats->lag_ns / stats->lag_calls / TIMER_NSEC_PER_USEC
+					   , stats->lag_max_ns / TIMER_NSEC_PER_USEC);
+		thread_stats_print_hist(fp, "    Run histogram:", stats->run_hist);
+	}
+
+	FREE(sorted);
+}
+#endif
+
 /* Call thread ! */
 void
 thread_call(thread_t * thread)
 {
+#ifdef _WITH_THREAD_STATS_
+	uint64_t start;
+#endif
+
 	thread->id = thread_get_id();
+#ifdef _WITH_THREAD_STATS_
+	start = timer_now_ns();
+	(*thread->func) (thread);
+	thread_stats_update(thread, start, timer_now_ns());
+#else
 	(*thread->func) (thread);
+#endif
 }
 
 /* Our infinite scheduling loop */
@@ -28,6 +28,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <errno.h>
 #include <syslog.h>
 #include <stdbool.h>
@@ -38,18 +39,24 @@
 typedef struct _thread {
 	unsigned long id;
 	unsigned char type;		/* thread type */
+	unsigned char priority;		/* ready queue dispatch class */
+	bool persistent;		/* read registration kept across dispatches */
 	struct _thread *next;		/* next pointer of the thread */
 	struct _thread *prev;		/* previous pointer of the thread */
 	struct _thread_master *master;	/* pointer to the struct thread_master. */
 	int (*func) (struct _thread *);	/* event function */
 	void *arg;			/* event argument */
-	timeval_t sands;		/* rest of time sands value. */
+	uint64_t sands;			/* expiry time, monotonic nanoseconds */
+	unsigned int heap_index;	/* position in the master timeout heap */
+	struct _thread_chunk *chunk;	/* slab chunk the thread belongs to */
+	struct _thread *child_next;	/* pid hash chain of a child thread */
 	union {
 		int val;		/* second argument of the event. */
 		int fd;			/* file descriptor in case of read/write. */
 		struct {
 			pid_t pid;	/* process id a child thread is wanting. */
 			int status;	/* return status of the process */
+			int fd;		/* pidfd of the process, or -1 */
 		} c;
 	} u;
 } thread_t;
@@ -61,19 +68,101 @@ typedef struct _thread_list {
 	int count;
 } thread_list_t;
 
+/* Number of buckets of the child pid hash, a power of 2 */
+#define THREAD_CHILD_HASH_SIZE	256
+
+/* Ready queue dispatch classes, higher runs first */
+#define THREAD_PRIORITY_NORMAL	0
+#define THREAD_PRIORITY_HIGH	1
+#define THREAD_PRIORITIES	2
+
+/* Slab chunk of threads, allocated cache line aligned. */
+#define THREAD_CHUNK_SIZE	64
+#define THREAD_CACHE_LINE	64
+
+typedef struct _thread_chunk {
+	struct _thread_chunk *next;
+	struct _thread_chunk *prev;
+	void *mem;			/* allocation backing the chunk */
+	unsigned int used;		/* threads handed out from this chunk */
+	thread_t threads[THREAD_CHUNK_SIZE] __attribute__((aligned(THREAD_CACHE_LINE)));
+} thread_chunk_t;
+
+/* thread_t allocator usage. */
+typedef struct _thread_alloc_stats {
+	unsigned long alloc;		/* threads allocated */
+	unsigned long in_use;		/* threads scheduled or running */
+	unsigned long pooled;		/* threads free for reuse */
+	unsigned long chunks;		/* slab chunks allocated */
+} thread_alloc_stats_t;
+
+#ifdef _WITH_THREAD_STATS_
+/* Run time histogram buckets, by power of 2 usecs: <1us, <2us, ... */
+#define THREAD_STATS_BUCKETS	24
+
+/* Dispatch statistics of a handler, keyed by function and thread type. */
+typedef struct _thread_stats {
+	int (*func) (struct _thread *);
+	unsigned char type;
+	unsigned long calls;
+	uint64_t run_ns;		/* cumulative run time */
+	uint64_t run_max_ns;
+	unsigned long lag_calls;	/* timed out threads */
+	uint64_t lag_ns;		/* cumulative lateness against sands */
+	uint64_t lag_max_ns;
+	unsigned long run_hist[THREAD_STATS_BUCKETS];
+} thread_stats_t;
+#endif
+
+/* Binary min-heap of threads, ordered by sands. */
+typedef struct _thread_heap {
+	thread_t **nodes;
+	unsigned int count;
+	unsigned int size;
+} thread_heap_t;
+
+/* I/O registration of a file descriptor, indexed by fd (epoll backend). */
+typedef struct _thread_event {
+	thread_t *read;			/* pending read thread */
+	thread_t *write;		/* pending write thread */
+	bool registered;		/* fd is known to the epoll set */
+	bool snmp;			/* fd is owned by the SNMP agent */
+} thread_event_t;
+
+struct epoll_event;
+
 /* Master of the threads. */
 typedef struct _thread_master {
-	thread_list_t read;
-	thread_list_t write;
-	thread_list_t timer;
-	thread_list_t child;
+	thread_heap_t read;
+	thread_heap_t write;
+	thread_heap_t timer;
+	thread_heap_t child;
+	thread_t *child_hash[THREAD_CHILD_HASH_SIZE];	/* child threads by pid */
 	thread_list_t event;
-	thread_list_t ready;
+	thread_list_t ready[THREAD_PRIORITIES];
 	thread_list_t unuse;
 	fd_set readfd;
 	fd_set writefd;
 	fd_set exceptfd;
+	int epoll_fd;
+	struct epoll_event *epoll_events;
+	thread_event_t *io_events;
+	int io_events_size;
+	int signal_fd;			/* signal fd registered to epoll */
+	pid_t timeout_pid;		/* timed out child being handled */
+	int timeout_pidfd;		/* and its pidfd, kept for signalling */
+	fd_set snmp_fds;		/* SNMP fds registered to epoll */
+	int snmp_fdsetsize;
+	thread_chunk_t *chunks;
+	unsigned long chunk_count;
+	unsigned long pool_max;		/* high-water mark of pooled threads */
 	unsigned long alloc;
+#ifdef _WITH_THREAD_STATS_
+	thread_stats_t *stats;		/* open addressed, by func and type */
+	unsigned int stats_count;
+	unsigned int stats_size;
+	unsigned long lag_hist[THREAD_STATS_BUCKETS];	/* loop lag of all timers */
+#endif
 } thread_master_t;
 
 /* Thread types. */
@@ -90,6 +179,12 @@ typedef struct _thread_master {
 #define THREAD_TERMINATE	10
 #define THREAD_READY_FD		11
 
+/* Default high-water mark of the unused thread pool */
+#define THREAD_POOL_MAX		1024
+
+/* Max number of epoll events reported per thread_fetch() wakeup */
+#define THREAD_EPOLL_EVENTS	256
+
 /* MICRO SEC def */
 #define BOOTSTRAP_DELAY TIMER_HZ
 #define RESPAWN_TIMER	60*TIMER_HZ
@@ -114,14 +209,27 @@ extern thread_master_t *thread_make_master(void);
 extern thread_t *thread_add_terminate_event(thread_master_t *);
 extern void thread_cleanup_master(thread_master_t *);
 extern void thread_destroy_master(thread_master_t *);
+extern void thread_set_pool_max(thread_master_t *, unsigned long);
+extern void thread_get_alloc_stats(thread_master_t *, thread_alloc_stats_t *);
+#ifdef _WITH_THREAD_STATS_
+extern void thread_dump_stats(thread_master_t *, FILE *);
+#endif
 extern thread_t *thread_add_read(thread_master_t *, int (*func) (thread_t *), void *, int, long);
+extern thread_t *thread_add_read_persistent(thread_master_t *, int (*func) (thread_t *), void *, int, long);
+extern void thread_set_read_timer(thread_t *, long);
 extern thread_t *thread_add_write(thread_master_t *, int (*func) (thread_t *), void *, int, long);
 extern thread_t *thread_add_timer(thread_master_t *, int (*func) (thread_t *), void *, long);
 extern thread_t *thread_add_child(thread_master_t *, int (*func) (thread_t *), void *, pid_t, long);
+extern int thread_child_kill(thread_t *, int);
+extern long thread_time_to_wakeup(thread_t *);
 extern thread_t *thread_add_event(thread_master_t *, int (*func) (thread_t *), void *, int);
 extern int thread_cancel(thread_t *);
+extern void thread_set_priority(thread_t *, unsigned char);
 extern thread_t *thread_fetch(thread_master_t *, thread_t *);
 extern void thread_call(thread_t *);
+#ifdef _WITH_SIMULATION_
+extern int thread_sim_fd_ready(thread_master_t *, int, bool);
+#endif
 extern void launch_scheduler(void);
 
 #endif
@@ -31,6 +31,10 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <stdbool.h>
+#ifdef _HAVE_SIGNALFD_
+#include <sys/signalfd.h>
+#endif
 #ifndef _DEBUG_
 #define NDEBUG
 #endif
@@ -57,6 +61,16 @@ static void *signal_SIGUSR2_v;
 
 static int signal_pipe[2] = { -1, -1 };
 
+#ifdef _HAVE_SIGNALFD_
+/* Handled signals stay blocked and are read from a signalfd */
+static int signal_fd = -1;
+static pid_t signal_fd_pid;		/* process which created signal_fd */
+static sigset_t signal_fd_set;
+
+/* Max number of signals read from the signalfd at once */
+#define SIGNAL_FD_BATCH	16
+#endif
+
 /* Remember our initial signal disposition */
 static sigset_t ign_sig;
 static sigset_t dfl_sig;
@@ -94,6 +108,22 @@ signal_handler(int sig)
 	}
 }
 
+#ifdef _HAVE_SIGNALFD_
+/* After fork() the signalfd is shared with the parent, so a child must
+ * drop it rather than update its mask */
+static void
+signal_fd_close(void)
+{
+	if (signal_fd == -1)
+		return;
+
+	close(signal_fd);
+	signal_fd = -1;
+	sigprocmask(SIG_UNBLOCK, &signal_fd_set, NULL);
+	sigemptyset(&signal_fd_set);
+}
+#endif
+
 /* Signal wrapper */
 void *
 signal_set(int signo, void (*func) (void *, int), void *v)
@@ -131,6 +161,25 @@ signal_set(int signo, void (*func) (void *, int), void *v)
 
 	ret = sigaction(signo, &sig, &osig);
 
+#ifdef _HAVE_SIGNALFD_
+	/* Only the process which created the signalfd may change its mask */
+	if (signal_fd != -1 && signal_fd_pid != getpid())
+		signal_fd_close();
+
+	/* Route the signal through the signalfd, or stop doing so */
+	if (signal_fd != -1) {
+		if (func != NULL)
+			sigaddset(&signal_fd_set, signo);
+		else {
+			sigdelset(&signal_fd_set, signo);
+			sigemptyset(&sset);
+			sigaddset(&sset, signo);
+			sigprocmask(SIG_UNBLOCK, &sset, NULL);
+		}
+		signalfd(signal_fd, &signal_fd_set, 0);
+	}
+#endif
+
 	switch(signo) {
 	case SIGHUP:
 		signal_SIGHUP_handler = func;
@@ -162,7 +211,11 @@ signal_set(int signo, void (*func) (void *, int), void *v)
 		return (SIG_ERR);
 
 	/* Release the signal */
+#ifdef _HAVE_SIGNALFD_
+	if (func != NULL && signal_fd == -1)
+#else
 	if (func != NULL)
+#endif
 		sigprocmask(SIG_UNBLOCK, &sset, NULL);
 
 	return ((osig.sa_flags & SA_SIGINFO) ? (void*)osig.sa_sigaction : (void*)osig.sa_handler);
@@ -202,6 +255,14 @@ signal_handler_init(void)
 	fcntl(signal_pipe[1], F_SETFD, FD_CLOEXEC | fcntl(signal_pipe[1], F_GETFD));
 #endif
 
+#ifdef _HAVE_SIGNALFD_
+	sigemptyset(&signal_fd_set);
+	signal_fd = signalfd(-1, &signal_fd_set, SFD_NONBLOCK | SFD_CLOEXEC);
+	signal_fd_pid = getpid();
+	if (signal_fd == -1)
+		log_message(LOG_INFO, "signalfd failed (%s), using signal pipe", strerror(errno));
+#endif
+
 	signal_SIGHUP_handler = NULL;
 	signal_SIGINT_handler = NULL;
 	signal_SIGTERM_handler = NULL;
@@ -257,6 +318,10 @@ signal_handlers_clear(void *state)
 void
 signal_handler_destroy(void)
 {
+#ifdef _HAVE_SIGNALFD_
+	/* Dropped before the handlers are cleared rather than updated */
+	signal_fd_close();
+#endif
 	signal_handlers_clear(SIG_IGN);
 	close(signal_pipe[1]);
 	close(signal_pipe[0]);
@@ -272,6 +337,12 @@ signal_handler_script(void)
 	struct sigaction ign, dfl;
 	int sig;
 
+#ifdef _HAVE_SIGNALFD_
+	/* The script and its system() must not touch the parent's signalfd,
+	 * and the signal mask is inherited across exec */
+	signal_fd_close();
+#endif
+
 	ign.sa_handler = SIG_IGN;
 	ign.sa_flags = 0;
 	sigemptyset(&ign.sa_mask);
@@ -290,45 +361,89 @@ signal_handler_script(void)
 int
 signal_rfd(void)
 {
+#ifdef _HAVE_SIGNALFD_
+	if (signal_fd != -1)
+		return(signal_fd);
+#endif
 	return(signal_pipe[0]);
 }
 
+/* Run the handler registered for a signal */
+static void
+signal_dispatch(int sig)
+{
+	switch(sig) {
+	case SIGHUP:
+		if (signal_SIGHUP_handler)
+			signal_SIGHUP_handler(signal_SIGHUP_v, SIGHUP);
+		break;
+	case SIGINT:
+		if (signal_SIGINT_handler)
+			signal_SIGINT_handler(signal_SIGINT_v, SIGINT);
+		break;
+	case SIGTERM:
+		if (signal_SIGTERM_handler)
+			signal_SIGTERM_handler(signal_SIGTERM_v, SIGTERM);
+		break;
+	case SIGCHLD:
+		if (signal_SIGCHLD_handler)
+			signal_SIGCHLD_handler(signal_SIGCHLD_v, SIGCHLD);
+		break;
+	case SIGUSR1:
+		if (signal_SIGUSR1_handler)
+			signal_SIGUSR1_handler(signal_SIGUSR1_v, SIGUSR1);
+		break;
+	case SIGUSR2:
+		if (signal_SIGUSR2_handler)
+			signal_SIGUSR2_handler(signal_SIGUSR2_v, SIGUSR2);
+		break;
+	default:
+		break;
+	}
+}
+
+#ifdef _HAVE_SIGNALFD_
+/* Read all queued signals from the signalfd, a batch per read() */
+static void
+signal_fd_run_callback(void)
+{
+	struct signalfd_siginfo info[SIGNAL_FD_BATCH];
+	bool child = false;
+	ssize_t len;
+	int i, n;
+
+	while ((len = read(signal_fd, info, sizeof(info))) > 0) {
+		n = len / sizeof(struct signalfd_siginfo);
+		for (i = 0; i < n; i++) {
+			/* One waitpid() loop reaps every exited child */
+			if (info[i].ssi_signo == SIGCHLD) {
+				child = true;
+				continue;
+			}
+			signal_dispatch(info[i].ssi_signo);
+		}
+	}
+
+	if (child)
+		signal_dispatch(SIGCHLD);
+}
+#endif
+
 /* Handlers callback  */
 void
 signal_run_callback(void)
 {
 	int sig;
 
-	while(read(signal_pipe[0], &sig, sizeof(int)) == sizeof(int)) {
-		switch(sig) {
-		case SIGHUP:
-			if (signal_SIGHUP_handler)
-				signal_SIGHUP_handler(signal_SIGHUP_v, SIGHUP);
-			break;
-		case SIGINT:
-			if (signal_SIGINT_handler)
-				signal_SIGINT_handler(signal_SIGINT_v, SIGINT);
-			break;
-		case SIGTERM:
-			if (signal_SIGTERM_handler)
-				signal_SIGTERM_handler(signal_SIGTERM_v, SIGTERM);
-			break;
-		case SIGCHLD:
-			if (signal_SIGCHLD_handler)
-				signal_SIGCHLD_handler(signal_SIGCHLD_v, SIGCHLD);
-			break;
-		case SIGUSR1:
-			if (signal_SIGUSR1_handler)
-				signal_SIGUSR1_handler(signal_SIGUSR1_v, SIGUSR1);
-			break;
-		case SIGUSR2:
-			if (signal_SIGUSR2_handler)
-				signal_SIGUSR2_handler(signal_SIGUSR2_v, SIGUSR2);
-			break;
-		default:
-			break;
-		}
+#ifdef _HAVE_SIGNALFD_
+	if (signal_fd != -1) {
+		signal_fd_run_callback();
+		return;
 	}
+#endif
+
+	while(read(signal_pipe[0], &sig, sizeof(int)) == sizeof(int))
+		signal_dispatch(sig);
 }
 
 void signal_pipe_close(int min_fd)
@@ -337,4 +452,8 @@ void signal_pipe_close(int min_fd)
 		close(signal_pipe[0]);
 	if (signal_pipe[1] && signal_pipe[1] >= min_fd)
 		close(signal_pipe[1]);
+#ifdef _HAVE_SIGNALFD_
+	if (signal_fd != -1 && signal_fd >= min_fd)
+		close(signal_fd);
+#endif
 }
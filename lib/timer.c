@@ -22,11 +22,12 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <errno.h>
+#include <time.h>
 #include "timer.h"
 
 /* time_now holds current time */
 timeval_t time_now;
+uint64_t time_now_ns;
 
 /* set a timer to a specific value */
 timeval_t
@@ -103,98 +104,66 @@ timer_add_long(timeval_t a, long b)
 	return ret;
 }
 
-/* This function is a wrapper for gettimeofday(). It uses local storage to
- * guarantee that the returned time will always be monotonic. If the time goes
- * backwards, it returns the same as previous one and readjust its internal
- * drift. If the time goes forward further than TIME_MAX_FORWARD_US
- * microseconds since last call, it will bound it to that value. It is designed
- * to be used as a drop-in replacement of gettimeofday(&now, NULL). It will
- * normally return 0, unless <now> is NULL, in which case it will return -1 and
- * set errno to EFAULT.
+#ifdef _WITH_SIMULATION_
+/*
+ * Simulation build: time is virtual and only moves forward when the
+ * scheduler has nothing left to run, see thread_fetch().
  */
-static int
-monotonic_gettimeofday(timeval_t *now)
-{
-	static timeval_t mono_date;
-	static timeval_t drift; /* warning: signed seconds! */
-	timeval_t sys_date, adjusted, deadline;
-
-	if (!now) {
-		errno = EFAULT;
-		return -1;
-	}
-
-	timer_reset_lazy(*now);
+static uint64_t time_virtual_ns = TIMER_NSEC_PER_SEC;
 
-	gettimeofday(&sys_date, NULL);
+uint64_t
+timer_now_ns(void)
+{
+	return time_virtual_ns;
+}
 
-	/* on first call, we set mono_date to system date */
-	if (mono_date.tv_sec == 0) {
-		mono_date = sys_date;
-		timer_reset(drift);
-		*now = mono_date;
-		return 0;
-	}
+/* move the virtual clock forward */
+void
+timer_sim_advance(uint64_t ns)
+{
+	time_virtual_ns += ns;
+}
+#else
+/*
+ * Time is read from CLOCK_MONOTONIC, so that wall clock jumps can't
+ * disturb timers. It is offset by the wall clock at startup so that
+ * times still read as dates, e.g. for the last transition time.
+ */
+static uint64_t time_offset_ns;
 
-	/* compute new adjusted time by adding the drift offset */
-	adjusted = timer_add(sys_date, drift);
+/* current time in nanoseconds */
+uint64_t
+timer_now_ns(void)
+{
+	struct timespec ts;
+	timeval_t tv;
+	uint64_t now;
 
-	/* check for jumps in the past, and bound to last date */
-	if (timer_cmp(adjusted, mono_date) < 0)
-		goto fixup;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (uint64_t) ts.tv_sec * TIMER_NSEC_PER_SEC + ts.tv_nsec;
 
-	/* check for jumps too far in the future, and bound them to
-	 * TIME_MAX_FORWARD_US microseconds.
-	 */
-	deadline = timer_add_long(mono_date, TIME_MAX_FORWARD_US);
-	if (timer_cmp (adjusted, deadline) >= 0) {
-		mono_date = deadline;
-		goto fixup;
+	if (!time_offset_ns) {
+		gettimeofday(&tv, NULL);
+		time_offset_ns = timer_ns(tv) - now;
 	}
 
-	/* adjusted date is correct */
-	mono_date = adjusted;
-	*now = mono_date;
-	return 0;
-
- fixup:
-	/* Now we have to recompute the drift between sys_date and
-	 * mono_date. Since it can be negative and we don't want to
-	 * play with negative carries in all computations, we take
-	 * care of always having the microseconds positive.
-	 */
-	drift = timer_sub(mono_date, sys_date);
-	*now = mono_date;
-	return 0;
+	return now + time_offset_ns;
 }
+#endif
 
 /* current time */
 timeval_t
 timer_now(void)
 {
-	timeval_t curr_time;
-	int old_errno = errno;
-
-	/* init timer */
-	if (monotonic_gettimeofday(&curr_time)) {
-		timer_reset(curr_time);
-		errno = old_errno;
-	}
-
-	return curr_time;
+	return timer_from_ns(timer_now_ns());
 }
 
-/* sets and returns current time from system time */
+/* sets and returns current time, cached for the scheduler iteration */
 timeval_t
 set_time_now(void)
 {
-	int old_errno = errno;
-
-	/* init timer */
-	if (monotonic_gettimeofday(&time_now)) {
-		timer_reset(time_now);
-		errno = old_errno;
-	}
+	time_now_ns = timer_now_ns();
+	time_now = timer_from_ns(time_now_ns);
 
 	return time_now;
 }
@@ -24,15 +24,19 @@
 #define _TIMER_H
 
 #include <sys/time.h>
+#include <stdint.h>
+#include <string.h>
 
 typedef struct timeval timeval_t;
 
 /* Global vars */
 extern timeval_t time_now;
+extern uint64_t time_now_ns;
 
 /* Some defines */
-#define TIME_MAX_FORWARD_US	2000000
 #define TIMER_HZ		1000000
+#define TIMER_NSEC_PER_USEC	1000
+#define TIMER_NSEC_PER_SEC	1000000000ULL
 #define TIMER_CENTI_HZ		10000
 #define TIMER_MAX_SEC		1000
 
@@ -48,7 +52,26 @@ extern timeval_t time_now;
 		timer_reset((T)); \
 	} while (0)
 
+/* Conversions between timeval_t and nanoseconds */
+static inline uint64_t
+timer_ns(timeval_t a)
+{
+	return (uint64_t) a.tv_sec * TIMER_NSEC_PER_SEC + (uint64_t) a.tv_usec * TIMER_NSEC_PER_USEC;
+}
+
+static inline timeval_t
+timer_from_ns(uint64_t ns)
+{
+	timeval_t a;
+
+	timer_reset_lazy(a);
+	a.tv_sec = ns / TIMER_NSEC_PER_SEC;
+	a.tv_usec = (ns % TIMER_NSEC_PER_SEC) / TIMER_NSEC_PER_USEC;
+	return a;
+}
+
 /* prototypes */
+extern uint64_t timer_now_ns(void);
 extern timeval_t timer_now(void);
 extern timeval_t set_time_now(void);
 extern timeval_t timer_dup(timeval_t);
@@ -60,5 +83,8 @@ extern timeval_t timer_sub_now(timeval_t);
 extern timeval_t timer_add_now(timeval_t);
 extern void timer_dump(timeval_t);
 extern unsigned long timer_tol(timeval_t);
+#ifdef _WITH_SIMULATION_
+extern void timer_sim_advance(uint64_t);
+#endif
 
 #endif
@@ -74,40 +74,70 @@ dump_buffer(char *buff, int count, FILE* fp)
 	}
 }
 
-/* Compute a checksum */
+/*
+ * Compute a checksum. csum is added to the sum, so the value stored in
+ * acc can be given back as csum to chain the checksum of several
+ * buffers, such as a pseudo header and a packet.
+ */
 u_short
 in_csum(u_short *addr, int len, int csum, int *acc)
 {
-	register int nleft = len;
-	const u_short *w = addr;
-	register u_short answer;
-	register int sum = csum;
+	const unsigned char *w = (const unsigned char *) addr;
+	uint64_t sum = (uint32_t) csum;
+	uint32_t w32[4];
+	uint16_t w16;
 
 	/*
-	 *  Our algorithm is simple, using a 32 bit accumulator (sum),
-	 *  we add sequential 16 bit words to it, and at the end, fold
-	 *  back all the carry bits from the top 16 bits into the lower
-	 *  16 bits.
+	 *  The one's complement sum doesn't depend on the word size, so
+	 *  32 bit words are added to a 64 bit accumulator, which can't
+	 *  overflow, and folded back to 16 bits at the end. Loads go
+	 *  through memcpy since the buffer may not be aligned.
 	 */
-	while (nleft > 1) {
-		sum += *w++;
-		nleft -= 2;
+	while (len >= 16) {
+		memcpy(w32, w, sizeof(w32));
+		sum += (uint64_t) w32[0] + w32[1] + w32[2] + w32[3];
+		w += 16;
+		len -= 16;
+	}
+	while (len >= 4) {
+		memcpy(w32, w, sizeof(uint32_t));
+		sum += w32[0];
+		w += 4;
+		len -= 4;
+	}
+	if (len >= 2) {
+		memcpy(&w16, w, sizeof(w16));
+		sum += w16;
+		w += 2;
+		len -= 2;
 	}
 
 	/* mop up an odd byte, if necessary */
-	if (nleft == 1)
-		sum += htons(*(u_char *) w << 8);
+	if (len == 1)
+		sum += htons(*w << 8);
+
+	/* fold to 16 bits, adding back the carry outs */
+	sum = (sum >> 32) + (sum & 0xffffffff);
+	sum = (sum >> 32) + (sum & 0xffffffff);
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum = (sum >> 16) + (sum & 0xffff);
 
 	if (acc)
-		*acc = sum;
+		*acc = (int) sum;
 
-	/*
-	 * add back carry outs from top 16 bits to low 16 bits
-	 */
-	sum = (sum >> 16) + (sum & 0xffff);	/* add hi 16 to low 16 */
-	sum += (sum >> 16);			/* add carry */
-	answer = ~sum;				/* truncate to 16 bits */
-	return (answer);
+	return (u_short) ~sum;
+}
+
+/* Update a checksum for a 16 bit word changed from old to new -- rfc1624.3 */
+u_short
+in_csum_update(u_short csum, u_short old, u_short new)
+{
+	register int sum;
+
+	sum = (u_short) ~csum + (u_short) ~old + new;
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum += (sum >> 16);
+	return ~sum;
 }
 
 /* IP network to ascii representation */
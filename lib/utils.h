@@ -51,6 +51,7 @@ extern unsigned long debug;
 /* Prototypes defs */
 extern void dump_buffer(char *, int, FILE *);
 extern u_short in_csum(u_short *, int, int, int *);
+extern u_short in_csum_update(u_short, u_short, u_short);
 extern char *inet_ntop2(uint32_t);
 extern uint8_t inet_stor(const char *);
 extern int domain_stosockaddr(const char *, const char *, struct sockaddr_storage *);
@@ -0,0 +1,133 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Checksum benchmark. Checks in_csum() against the former
+ *              16 bit word implementation on random buffers, then times
+ *              both on advert sized and MTU sized buffers.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2016 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* keepalived includes */
+#include "utils.h"
+
+#define BENCH_BUF_SIZE		2048
+#define BENCH_CHECKS		100000
+
+/* The former implementation, the reference for the results */
+static u_short
+ref_in_csum(u_short *addr, int len, int csum, int *acc)
+{
+	register int nleft = len;
+	const u_short *w = addr;
+	register u_short answer;
+	register int sum = csum;
+
+	while (nleft > 1) {
+		sum += *w++;
+		nleft -= 2;
+	}
+
+	if (nleft == 1)
+		sum += htons(*(u_char *) w << 8);
+
+	if (acc)
+		*acc = sum;
+
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum += (sum >> 16);
+	answer = ~sum;
+	return (answer);
+}
+
+typedef u_short (*csum_fn)(u_short *, int, int, int *);
+
+/* Random buffers, lengths and offsets, alone and chained after a pseudo header */
+static int
+bench_check(unsigned char *buf)
+{
+	int i, j, len, off, acc, ref_acc, bad = 0;
+
+	for (i = 0; i < BENCH_CHECKS; i++) {
+		len = rand() % 1600;
+		off = rand() % 8;
+		for (j = 0; j < len; j++)
+			buf[off + j] = (i % 7) ? rand() : 0xff;
+
+		if (in_csum((u_short *) (buf + off), len, 0, NULL) !=
+		    ref_in_csum((u_short *) (buf + off), len, 0, NULL))
+			bad++;
+
+		in_csum((u_short *) buf, 12, 0, &acc);
+		ref_in_csum((u_short *) buf, 12, 0, &ref_acc);
+		if (in_csum((u_short *) (buf + 16), len, acc, NULL) !=
+		    ref_in_csum((u_short *) (buf + 16), len, ref_acc, NULL))
+			bad++;
+	}
+
+	return bad;
+}
+
+static double
+bench_time(csum_fn fn, unsigned char *buf, int len, unsigned long loops)
+{
+	struct timespec start, end;
+	volatile u_short res;
+	unsigned long i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < loops; i++) {
+		buf[0] = i;
+		res = fn((u_short *) buf, len, 0, NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	(void) res;
+
+	return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / loops;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const int lens[] = { 20, 40, 1500 };
+	unsigned char *buf;
+	unsigned long loops;
+	unsigned i;
+	int bad;
+
+	loops = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+
+	buf = malloc(BENCH_BUF_SIZE);
+	srand(1);
+	bad = bench_check(buf);
+	printf("in_csum: %d mismatches in %d random checks\n", bad, 2 * BENCH_CHECKS);
+
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		printf("  %4d bytes: in_csum %6.1f ns, former %6.1f ns\n", lens[i],
+		       bench_time(in_csum, buf, lens[i], loops / (1 + lens[i] / 64)),
+		       bench_time(ref_in_csum, buf, lens[i], loops / (1 + lens[i] / 64)));
+	}
+
+	free(buf);
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Netlink reflector benchmark. Replays RTM_NEWLINK and
+ *              RTM_NEWADDR storms for synthetic interfaces through the
+ *              kernel reflector filter, as when a host with thousands of
+ *              interfaces flaps or renumbers them. First checks that
+ *              requests whose ack was lost are failed.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2016 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+/* The filters are static, the bench is built with them */
+#include "../keepalived/vrrp/vrrp_netlink.c"
+#include "global_data.h"
+
+/* Synthetic interfaces are numbered above any real one */
+#define BENCH_IFINDEX_BASE	100000
+#define BENCH_MSG_SIZE		256
+#define BENCH_ACKS		6
+
+/* Symbols of the daemon the netlink code refers to */
+data_t *global_data;
+#ifdef _HAVE_VRRP_VMAC_
+const char * const macvlan_ll_kind = "macvlan";
+#endif
+#ifdef _WITH_LVS_
+void
+update_checker_activity(sa_family_t family, void *address, int enable)
+{
+}
+#endif
+
+typedef struct {
+	struct nlmsghdr n;
+	union {
+		struct ifinfomsg ifi;
+		struct ifaddrmsg ifa;
+	};
+	char buf[BENCH_MSG_SIZE];
+} bench_msg_t;
+
+static void
+bench_link_msg(bench_msg_t *msg, unsigned i, unsigned flags)
+{
+	char ifname[IFNAMSIZ];
+	unsigned char hwaddr[ETH_ALEN] = { 0x02, 0, 0, i >> 16, i >> 8, i };
+	uint32_t mtu = 1500;
+
+	memset(msg, 0, sizeof(*msg));
+	msg->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	msg->n.nlmsg_type = RTM_NEWLINK;
+	msg->ifi.ifi_family = AF_UNSPEC;
+	msg->ifi.ifi_type = ARPHRD_ETHER;
+	msg->ifi.ifi_index = BENCH_IFINDEX_BASE + i;
+	msg->ifi.ifi_flags = flags;
+
+	snprintf(ifname, sizeof(ifname), "bench%u", i);
+	addattr_l(&msg->n, sizeof(*msg), IFLA_IFNAME, ifname, strlen(ifname) + 1);
+	addattr32(&msg->n, sizeof(*msg), IFLA_MTU, mtu);
+	addattr_l(&msg->n, sizeof(*msg), IFLA_ADDRESS, hwaddr, sizeof(hwaddr));
+}
+
+static void
+bench_addr_msg(bench_msg_t *msg, unsigned i)
+{
+	uint32_t addr = htonl(0x0a000000 | i);
+
+	memset(msg, 0, sizeof(*msg));
+	msg->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+	msg->n.nlmsg_type = RTM_NEWADDR;
+	msg->ifa.ifa_family = AF_INET;
+	msg->ifa.ifa_prefixlen = 8;
+	msg->ifa.ifa_index = BENCH_IFINDEX_BASE + i;
+
+	addattr_l(&msg->n, sizeof(*msg), IFA_LOCAL, &addr, sizeof(addr));
+	addattr_l(&msg->n, sizeof(*msg), IFA_ADDRESS, &addr, sizeof(addr));
+}
+
+/*
+ * Requests whose ack was lost must fail with -ENOBUFS, even when the acks
+ * of later requests report success.
+ */
+static int bench_ack_error[BENCH_ACKS];
+
+static void
+bench_ack_done(void *item, int cmd, int error)
+{
+	bench_ack_error[(long) item] = error;
+}
+
+static void
+bench_ack(__u32 seq, int error)
+{
+	struct {
+		struct nlmsghdr n;
+		struct nlmsgerr err;
+	} ack;
+
+	memset(&ack, 0, sizeof(ack));
+	ack.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct nlmsgerr));
+	ack.n.nlmsg_type = NLMSG_ERROR;
+	ack.n.nlmsg_seq = seq;
+	ack.err.error = error;
+	netlink_cmd_ack(&ack.n);
+}
+
+static int
+bench_check_acks(void)
+{
+	static const int expect[BENCH_ACKS] = {
+		-ENOBUFS, 0, -ENOBUFS, -ENOBUFS, 0, -ENOBUFS
+	};
+	struct nlmsghdr n;
+	__u32 seq;
+	long i;
+	int bad = 0;
+
+	master = thread_make_master();
+	nl_cmd_pending = alloc_list(free_nl_cmd_req, NULL);
+	netlink_socket(&nl_cmd, SOCK_NONBLOCK, 0);
+
+	memset(&n, 0, sizeof(n));
+	n.nlmsg_type = RTM_NEWROUTE;
+	seq = nl_cmd.seq + 1;
+	for (i = 0; i < BENCH_ACKS; i++) {
+		n.nlmsg_seq = ++nl_cmd.seq;
+		bench_ack_error[i] = 1;
+		netlink_cmd_pending_add(&n, 0, bench_ack_done, (void *) i);
+	}
+
+	/* Only the second and fifth requests are answered, then an overrun */
+	bench_ack(seq + 1, 0);
+	bench_ack(seq + 4, -EEXIST);
+	netlink_cmd_fail(-ENOBUFS);
+
+	for (i = 0; i < BENCH_ACKS; i++) {
+		if (bench_ack_error[i] != expect[i])
+			bad++;
+	}
+
+	if (nl_cmd.thread)
+		thread_cancel(nl_cmd.thread);
+	nl_cmd.thread = NULL;
+	free_list(&nl_cmd_pending);
+	netlink_close(&nl_cmd);
+	thread_destroy_master(master);
+	master = NULL;
+
+	return bad;
+}
+
+/* Feed the messages in an order unrelated to the creation one */
+static double
+bench_storm(bench_msg_t *msgs, unsigned n, unsigned rounds)
+{
+	struct timespec start, end;
+	unsigned i, r;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < n; i++)
+			netlink_broadcast_filter(NULL, &msgs[(i * 7919UL) % n].n);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) /
+	       ((double) n * rounds);
+}
+
+int
+main(int argc, char **argv)
+{
+	bench_msg_t *msgs;
+	unsigned n, rounds, i;
+	double ns;
+	int bad;
+
+	n = (argc > 1) ? atoi(argv[1]) : 10000;
+	rounds = (argc > 2) ? atoi(argv[2]) : 10;
+	if (!n || !rounds) {
+		fprintf(stderr, "Usage: %s [interfaces] [rounds]\n", argv[0]);
+		exit(1);
+	}
+
+	bad = bench_check_acks();
+	printf("lost acks: %d mismatches in %d requests\n", bad, BENCH_ACKS);
+	if (bad)
+		return 1;
+
+	/* Start from the interfaces of the host, like the daemon */
+	init_interface_queue();
+	msgs = (bench_msg_t *) MALLOC(n * sizeof(bench_msg_t));
+
+	for (i = 0; i < n; i++)
+		bench_link_msg(&msgs[i], i, IFF_UP | IFF_RUNNING);
+	ns = bench_storm(msgs, n, 1);
+	printf("%u interfaces, %u rounds\n", n, rounds);
+	printf("  RTM_NEWLINK new:   %8.1f ns/msg\n", ns);
+
+	for (i = 0; i < n; i++)
+		bench_link_msg(&msgs[i], i, (i & 1) ? IFF_UP : IFF_UP | IFF_RUNNING);
+	printf("  RTM_NEWLINK flags: %8.1f ns/msg\n", bench_storm(msgs, n, rounds));
+
+	for (i = 0; i < n; i++)
+		bench_addr_msg(&msgs[i], i);
+	printf("  RTM_NEWADDR:       %8.1f ns/msg\n", bench_storm(msgs, n, rounds));
+
+	/* Every interface must be known by index and name, with its address */
+	for (i = 0; i < n; i++) {
+		char ifname[IFNAMSIZ];
+		interface_t *ifp;
+
+		snprintf(ifname, sizeof(ifname), "bench%u", i);
+		ifp = if_get_by_ifindex(BENCH_IFINDEX_BASE + i);
+		if (!ifp || ifp != if_get_by_ifname(ifname) ||
+		    ifp->sin_addr.s_addr != htonl(0x0a000000 | i))
+			break;
+	}
+
+	FREE(msgs);
+	free_interface_queue();
+
+	if (i != n) {
+		fprintf(stderr, "interface %u missing\n", i);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Scheduler benchmark. Runs synthetic workloads on the
+ *              simulation build of the scheduler, where time is virtual
+ *              and fds are fake, so that a minute of timers and checks
+ *              runs as fast as the scheduler can dispatch it.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2016 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+/* system includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* keepalived includes */
+#include "scheduler.h"
+#include "signals.h"
+#include "memory.h"
+
+#ifndef _WITH_SIMULATION_
+#error "sched-bench needs the simulation build of the scheduler"
+#endif
+
+/* First fake fd handed to checkers and VRRP instances */
+#define BENCH_FD_BASE		16
+
+#define BENCH_CHECK_DELAY	(5 * TIMER_HZ)
+#define BENCH_CHECK_TIMEOUT	(3 * TIMER_HZ)
+#define BENCH_ADVERT_INT	TIMER_HZ
+
+typedef struct _bench_conn {
+	int fd;
+	long delay;		/* network latency of the peer, 0 when it is down */
+	thread_t *thread;	/* persistent read registration (vrrp) */
+} bench_conn_t;
+
+/* Timers workload: periodic timers with assorted periods */
+static int
+bench_timer_thread(thread_t * thread)
+{
+	long period = (long) THREAD_ARG(thread);
+
+	thread_add_timer(thread->master, bench_timer_thread, THREAD_ARG(thread), period);
+	return 0;
+}
+
+static void
+bench_timers_init(thread_master_t * m, unsigned n)
+{
+	unsigned i;
+
+	for (i = 0; i < n; i++)
+		thread_add_timer(m, bench_timer_thread,
+				 (void *) (long) (TIMER_HZ / 1000 * (1 + (i * 7919) % 1000)),
+				 i % 1000 * (TIMER_HZ / 1000));
+}
+
+/* The peer answers the pending request after its latency */
+static int
+bench_net_thread(thread_t * thread)
+{
+	bench_conn_t *conn = THREAD_ARG(thread);
+
+	thread_sim_fd_ready(thread->master, conn->fd, THREAD_VAL(thread));
+	return 0;
+}
+
+static void
+bench_net_send(thread_master_t * m, bench_conn_t * conn, bool write)
+{
+	thread_t *thread;
+
+	if (!conn->delay)
+		return;
+	thread = thread_add_timer(m, bench_net_thread, conn, conn->delay);
+	THREAD_VAL(thread) = write;
+}
+
+/* Checkers workload: connect, send and read, like TCP_CHECK and HTTP_GET */
+static int bench_check_thread(thread_t *);
+
+static int
+bench_check_read_thread(thread_t * thread)
+{
+	thread_add_timer(thread->master, bench_check_thread, THREAD_ARG(thread),
+			 BENCH_CHECK_DELAY);
+	return 0;
+}
+
+static int
+bench_check_connected_thread(thread_t * thread)
+{
+	bench_conn_t *conn = THREAD_ARG(thread);
+
+	if (thread->type == THREAD_WRITE_TIMEOUT) {
+		thread_add_timer(thread->master, bench_check_thread, conn,
+				 BENCH_CHECK_DELAY);
+		return 0;
+	}
+
+	thread_add_read(thread->master, bench_check_read_thread, conn,
+			conn->fd, BENCH_CHECK_TIMEOUT);
+	bench_net_send(thread->master, conn, false);
+	return 0;
+}
+
+static int
+bench_check_thread(thread_t * thread)
+{
+	bench_conn_t *conn = THREAD_ARG(thread);
+
+	thread_add_write(thread->master, bench_check_connected_thread, conn,
+			 conn->fd, BENCH_CHECK_TIMEOUT);
+	bench_net_send(thread->master, conn, true);
+	return 0;
+}
+
+/*
+ * VRRP workload: adverts received on a dispatcher fd, and sent on timers.
+ * Like the VRRP dispatcher the fd stays registered, the read handler
+ * only moves its timeout.
+ */
+static int
+bench_vrrp_read_thread(thread_t * thread)
+{
+	bench_conn_t *conn = THREAD_ARG(thread);
+
+	thread_set_read_timer(conn->thread, 3 * BENCH_ADVERT_INT);
+	return 0;
+}
+
+static void
+bench_vrrp_listen(thread_master_t * m, bench_conn_t * conn)
+{
+	conn->thread = thread_add_read_persistent(m, bench_vrrp_read_thread, conn,
+						  conn->fd, 3 * BENCH_ADVERT_INT);
+	thread_set_priority(conn->thread, THREAD_PRIORITY_HIGH);
+}
+
+static int
+bench_vrrp_advert_thread(thread_t * thread)
+{
+	bench_conn_t *conn = THREAD_ARG(thread);
+
+	bench_net_send(thread->master, conn, false);
+	thread_add_timer(thread->master, bench_vrrp_advert_thread, conn,
+			 BENCH_ADVERT_INT);
+	return 0;
+}
+
+static bench_conn_t *
+bench_conns_init(thread_master_t * m, unsigned n, bool vrrp)
+{
+	bench_conn_t *conns;
+	unsigned i;
+
+	conns = (bench_conn_t *) MALLOC(n * sizeof(bench_conn_t));
+	for (i = 0; i < n; i++) {
+		conns[i].fd = BENCH_FD_BASE + i;
+		conns[i].delay = 100 + i % 1000;
+
+		if (vrrp) {
+			bench_vrrp_listen(m, &conns[i]);
+			thread_add_timer(m, bench_vrrp_advert_thread, &conns[i],
+					 i % 1000 * (TIMER_HZ / 1000));
+			continue;
+		}
+
+		/* One server in ten is down */
+		if (i % 10 == 9)
+			conns[i].delay = 0;
+		thread_add_timer(m, bench_check_thread, &conns[i],
+				 i % 5000 * (TIMER_HZ / 1000));
+	}
+
+	return conns;
+}
+
+static int
+bench_stop_thread(thread_t * thread)
+{
+	thread_add_terminate_event(thread->master);
+	return 0;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s timers|checkers|vrrp [count] [virtual seconds]\n", prog);
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct timespec start, end;
+	thread_alloc_stats_t stats;
+	bench_conn_t *conns = NULL;
+	thread_t thread;
+	unsigned long events = 0;
+	unsigned n, secs;
+	double elapsed;
+
+	if (argc < 2)
+		usage(argv[0]);
+	n = (argc > 2) ? atoi(argv[2]) : 0;
+	secs = (argc > 3) ? atoi(argv[3]) : 60;
+
+	signal_handler_init();
+	master = thread_make_master();
+
+	if (!strcmp(argv[1], "timers")) {
+		if (!n)
+			n = 10000;
+		bench_timers_init(master, n);
+	} else if (!strcmp(argv[1], "checkers") || !strcmp(argv[1], "vrrp")) {
+		if (!n)
+			n = (argv[1][0] == 'c') ? 5000 : 100;
+#ifndef _HAVE_EPOLL_
+		/* select() can't watch the fake fds beyond FD_SETSIZE */
+		if (n > FD_SETSIZE - BENCH_FD_BASE)
+			n = FD_SETSIZE - BENCH_FD_BASE;
+#endif
+		conns = bench_conns_init(master, n, argv[1][0] == 'v');
+	} else
+		usage(argv[0]);
+
+	thread_add_timer(master, bench_stop_thread, NULL, (long) secs * TIMER_HZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (thread_fetch(master, &thread)) {
+		thread_call(&thread);
+		events++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	thread_get_alloc_stats(master, &stats);
+	printf("%s: %u items, %u virtual secs\n", argv[1], n, secs);
+	printf("  %lu events in %.3f secs, %.0f events/sec, %.0f ns/event\n",
+	       events, elapsed, events / elapsed, elapsed * 1e9 / (events ? events : 1));
+	printf("  %lu threads allocated, %lu chunks\n", stats.alloc, stats.chunks);
+
+	thread_destroy_master(master);
+	if (conns)
+		FREE(conns);
+
+	return 0;
+}
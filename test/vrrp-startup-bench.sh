@@ -0,0 +1,114 @@
+#!/bin/bash
+#
+# VRRP startup benchmark. Generates a synthetic configuration of COUNT
+# BACKUP instances, in sync groups of two, over veth interfaces of a
+# scratch network namespace, 255 VRIDs per interface. Times keepalived
+# from launch until every instance has entered BACKUP state, then the
+# same after a reload. Needs root, and a syslog daemon on /dev/log:
+# without one every log line falls back to the console, and that is
+# what gets timed.
+#
+# Usage: vrrp-startup-bench.sh [count] [keepalived binary]
+
+LANG=C
+
+: ${COUNT:=${1:-4000}}
+: ${KEEPALIVED:=${2:-../bin/keepalived}}
+: ${NETNS:=ka-startup-bench}
+: ${TIMEOUT:=300}
+
+WORKDIR=$(mktemp -d)
+CONF=${WORKDIR}/keepalived.conf
+LOG=${WORKDIR}/keepalived.log
+NIFS=$(( (COUNT + 254) / 255 ))
+
+die() {
+	echo "$*"
+	exit 1
+}
+
+cleanup() {
+	[[ -f ${WORKDIR}/keepalived.pid ]] && kill -TERM $(cat ${WORKDIR}/keepalived.pid) 2>/dev/null
+	sleep 1
+	ip netns del ${NETNS} 2>/dev/null
+	rm -rf ${WORKDIR}
+}
+
+setup_netns() {
+	local i
+
+	ip netns add ${NETNS} || die "can't create network namespace ${NETNS}"
+	ip -n ${NETNS} link set lo up
+	for (( i = 0; i < NIFS; i++ )); do
+		ip -n ${NETNS} link add kab${i} type veth peer name kabp${i} ||
+			die "can't create interface kab${i}"
+		ip -n ${NETNS} addr add 10.$(( 128 + i / 256 )).$(( i % 256 )).1/24 dev kab${i}
+		ip -n ${NETNS} link set kab${i} up
+		ip -n ${NETNS} link set kabp${i} up
+	done
+}
+
+gen_config() {
+	local i
+
+	echo "global_defs {"
+	echo "  router_id startup_bench"
+	echo "}"
+	for (( i = 0; i < COUNT; i += 2 )); do
+		echo "vrrp_sync_group G_${i} {"
+		echo "  group {"
+		echo "    VI_${i}"
+		(( i + 1 < COUNT )) && echo "    VI_$(( i + 1 ))"
+		echo "  }"
+		echo "}"
+	done
+	for (( i = 0; i < COUNT; i++ )); do
+		echo "vrrp_instance VI_${i} {"
+		echo "  state BACKUP"
+		echo "  interface kab$(( i / 255 ))"
+		echo "  virtual_router_id $(( i % 255 + 1 ))"
+		echo "  priority 100"
+		echo "  advert_int 1"
+		echo "  virtual_ipaddress {"
+		echo "    10.$(( 64 + i / 65536 )).$(( i / 256 % 256 )).$(( i % 256 ))/32"
+		echo "  }"
+		echo "}"
+	done
+}
+
+# Wait until the log holds $1 lines for instances entering BACKUP
+wait_backup() {
+	local want=$1 start=$2 now
+
+	while (( $(grep -c "Entering BACKUP STATE" ${LOG}) < want )); do
+		grep -q "^Stopped Keepalived" ${LOG} && die "keepalived stopped: $(tail -3 ${LOG})"
+		now=$(date +%s)
+		(( now - ${start%.*} > TIMEOUT )) && die "timed out after ${TIMEOUT} secs"
+		sleep 0.05
+	done
+}
+
+elapsed() {
+	awk -v start=$1 -v now=$(date +%s.%N) 'BEGIN { printf "%.2f", now - start }'
+}
+
+[[ $(id -u) -eq 0 ]] || die "must be run as root"
+test -x "${KEEPALIVED}" || die "keepalived binary required (tried ${KEEPALIVED})"
+
+trap cleanup EXIT
+
+setup_netns
+gen_config > ${CONF}
+echo "${COUNT} instances over ${NIFS} interfaces"
+
+start=$(date +%s.%N)
+ip netns exec ${NETNS} ${KEEPALIVED} -n -l -P -f ${CONF} \
+	-p ${WORKDIR}/keepalived.pid -r ${WORKDIR}/vrrp.pid > ${LOG} 2>&1 &
+wait_backup ${COUNT} ${start}
+echo "  startup: $(elapsed ${start}) secs"
+
+while [[ ! -s ${WORKDIR}/keepalived.pid ]]; do sleep 0.05; done
+start=$(date +%s.%N)
+kill -HUP $(cat ${WORKDIR}/keepalived.pid)
+wait_backup $(( 2 * COUNT )) ${start}
+echo "  reload: $(elapsed ${start}) secs"